@@ -15,43 +15,555 @@
 #ifndef ELRAT_TESTBENCH_H
 #define ELRAT_TESTBENCH_H
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iomanip>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <regex>
 #include <stdexcept>
 #include <sstream>
+#include <thread>
 #include <type_traits>
+#include <typeinfo>
 #include <vector>
 
+#if defined(__unix__) || defined(__APPLE__)
+#define ELRAT_TESTBENCH_FORK
+#define ELRAT_TESTBENCH_MMAP
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+// Formats the message of a failed check, e.g.
+// 	ELRAT_TESTBENCH_FORMAT( "Expected [{}], but found [{}].", b, a )
+// The number of placeholders must match the number of arguments, which is
+// checked at compile time. For use within the testbench only.
+#define ELRAT_TESTBENCH_FORMAT( fmt, ... ) \
+	intern::format( \
+		intern::arity< intern::placeholders( fmt ) >(), \
+		fmt, \
+		__VA_ARGS__ )
+
+// Registers a testcase in the static registry, from any translation unit.
+// The body receives the testcase as 'tc', e.g.
+// 	ELRAT_TESTCASE( "addition" ) {
+// 		tc.equal( 1 + 1, 2 );
+// 	}
+// Registered testcases are defined by 'testbench::define_registered'. 
+// Defining ELRAT_TESTBENCH_MAIN in one translation unit before including 
+// this header generates a 'main', which runs them (see 'testbench::main').
+#define ELRAT_TESTCASE( name ) \
+	ELRAT_TESTBENCH_TESTCASE( \
+		name, \
+		ELRAT_TESTBENCH_CONCAT( \
+			elrat_testbench_testcase_, \
+			ELRAT_TESTBENCH_ID ) )
+
+// Unique within a translation unit. Without __COUNTER__, testcases must be
+// registered on separate lines.
+#ifdef __COUNTER__
+#define ELRAT_TESTBENCH_ID __COUNTER__
+#else
+#define ELRAT_TESTBENCH_ID __LINE__
+#endif
+
+#define ELRAT_TESTBENCH_TESTCASE( name, id ) \
+	static void id( ::elrat::testbench::testcase& tc ); \
+	static ::elrat::testbench::registration \
+		ELRAT_TESTBENCH_CONCAT( id, _registration )( name, id ); \
+	static void id( ::elrat::testbench::testcase& tc )
+
+#define ELRAT_TESTBENCH_CONCAT( a, b ) ELRAT_TESTBENCH_CONCAT_( a, b )
+#define ELRAT_TESTBENCH_CONCAT_( a, b ) a##b
+
+// Selects what checks record. It must be the same in all translation units
+// of a program, e.g. defined by the build system.
+// 	ELRAT_TESTBENCH_CHECKS_FULL    (default) Checks are counted. Failed 
+// 	                               checks are recorded with their message,
+// 	                               and exceptions thrown by comparisons 
+// 	                               fail the check.
+// 	ELRAT_TESTBENCH_CHECKS_COUNT   Checks and failed checks are counted 
+// 	                               only, without messages.
+// 	ELRAT_TESTBENCH_CHECKS_NONE    Passing checks cost nothing but the 
+// 	                               comparison. Only failed checks are 
+// 	                               counted and recorded with their message.
+// Except for full diagnostics, exceptions thrown by comparisons are not 
+// caught by the check, but fail the testcase (see 'testbench::run').
+#define ELRAT_TESTBENCH_CHECKS_NONE 0
+#define ELRAT_TESTBENCH_CHECKS_COUNT 1
+#define ELRAT_TESTBENCH_CHECKS_FULL 2
+
+#ifndef ELRAT_TESTBENCH_CHECKS
+#define ELRAT_TESTBENCH_CHECKS ELRAT_TESTBENCH_CHECKS_FULL
+#endif
+
 namespace elrat {
 
 //--- DECLARATION -------------------------------------------------------------
 
 class testbench {
-private:
+public:
+	// Snapshot of the totals of a testbench.
+	struct counts {
+		counts();
+		int testcases;
+		int checks;
+		int failed_testcases;
+		int failed_checks;
+	};
+
+	// Resources used by a testcase, between its creation and destruction.
+	// Allocations are only counted, if they're tracked (see 
+	// 'testbench::allocations').
+	struct resources {
+		resources();
+		std::chrono::nanoseconds wall_time;
+		std::chrono::nanoseconds cpu_time; // of the thread
+		long long allocations;
+		long long allocated_bytes;
+	};
+
+	// Limits to stop testing early, once things went wrong, and settings
+	// of the benchmarks. Zero stands for 'no limit'.
+	struct policy {
+		policy();
+
+		// Further checks of a testcase are skipped, once it has that
+		// many failed checks.
+		int max_failed_checks;
+
+		// Further testcases are skipped, once that many testcases 
+		// failed.
+		int max_failed_testcases;
+
+		// Further failed checks of a testcase are still counted, but no
+		// longer recorded with their message.
+		int max_entries;
+
+		// Memory for the messages of failed checks, of all testcases. 
+		// Once exceeded, the newest messages are dropped, or if 
+		// 'drop_oldest_messages' is set, the oldest ones.
+		std::size_t max_message_bytes;
+		bool drop_oldest_messages;
+
+		// A benchmark takes that many samples. The number of 
+		// iterations per sample is scaled up until a sample takes at
+		// least 'sample_time'.
+		int samples;
+		std::chrono::nanoseconds sample_time;
+
+		// A benchmark is considered a regression compared to its 
+		// baseline, if it's slower by more than the relative tolerance
+		// with a significance level of 'significance'.
+		double regression_tolerance;
+		double significance;
+
+		// If false, the results of testcases are only counted and 
+		// passed to the reporters, but not kept in memory.
+		bool retain_logs;
+
+		// A testcase, that runs longer than 'testcase_timeout', fails.
+		// In-process, a watchdog thread then records the failure, flushes
+		// the results and terminates the process with exit code 1, since
+		// the testcase cannot be stopped. 'run_isolated' terminates the 
+		// worker process instead. The same applies to all running 
+		// testcases, once the testbench runs longer than 'global_timeout'
+		// (since construction) and the remaining defined testcases are 
+		// not executed. Zero disables the timeout.
+		std::chrono::milliseconds testcase_timeout;
+		std::chrono::milliseconds global_timeout;
+
+		// Number of testcases listed as the slowest ones.
+		int slowest_testcases;
+
+		// Checks of ranges report that many mismatching elements.
+		int max_mismatches;
+
+		// 'testcase::for_all' checks a property with that many cases, 
+		// unless it runs longer than 'property_budget' (if not zero).
+		// A counterexample is shrunk with at most 'property_shrinks'
+		// attempts. The cases are derived from the seed and the name of 
+		// the testcase, so they're the same for every run.
+		int property_cases;
+		std::chrono::milliseconds property_budget;
+		int property_shrinks;
+		std::uint64_t property_seed;
+
+		// The cases are split into that many shards, which are checked
+		// by concurrent threads with their own seeds. 0 uses one shard
+		// per hardware thread. Properties must be thread-safe then.
+		int property_shards;
+
+		// Golden files of 'testcase::matches_golden' are relative to 
+		// that directory, if it's not empty. In update mode, a differing
+		// or missing golden file is replaced instead of failing the 
+		// check. It's enabled by default, if the environment variable
+		// ELRAT_TESTBENCH_UPDATE_GOLDENS is set and not "0".
+		std::string golden_directory;
+		bool update_goldens;
+	};
+
 	struct log;
+	struct benchmark;
+	class reporter;
+	class json_lines_reporter;
+	class junit_reporter;
+	class registration;
+
+	// Heap allocations of a thread. They're only counted, if the macro 
+	// ELRAT_TESTBENCH_TRACK_ALLOCATIONS is defined in one translation unit
+	// before including this header, which replaces the global operator 
+	// new and delete.
+	struct allocations {
+		long long count;
+		long long bytes;
+
+		// counters of the calling thread
+		static allocations& current();
+		static bool& tracked();
+	};
+
+	// Property-based testing, see 'testcase::for_all'. Generators have a 
+	// 'value_type' and fill a value with choices drawn from a source.
+	class source;
+	template <class T> class integers;
+	template <class T> class floats;
+	class strings;
+	template <class Generator> class vectors;
+
+	template <class Generator>
+	static vectors<Generator> vectors_of( 
+		const Generator& g, 
+		std::size_t max_size = 32 );
+private:
 	struct intern;
+	struct job;
+	struct fixture_state;
+	struct submission;
+	class scheduler;
+	class arena;
+	class watchdog;
+	class mapping;
 
 	std::string m_name;
-	std::vector<log> m_logs;
+	std::vector<job> m_jobs;
+	policy m_policy;
+	std::atomic<int> m_failed_submissions;
+	std::unique_ptr<arena> m_arena; // messages of failed checks
+	std::vector<benchmark> m_benchmarks;
+	mutable std::mutex m_benchmark_lock;
+	std::vector<reporter*> m_reporters;
+	std::atomic<bool> m_reporting;
+	std::mutex m_report_lock;
+
+	// Results are submitted to a lock-free stack, and moved into the 
+	// vector of logs when they're queried. The totals are updated along
+	// the way.
+	mutable std::atomic<submission*> m_submitted;
+	mutable std::mutex m_drain;
+	mutable std::vector<log> m_logs;
+	mutable counts m_counts;
+	mutable std::size_t m_dropped; // by arenas of discarded logs
+	mutable std::vector<std::pair<std::string,resources>> m_slowest;
 
-	// called by child testcases to submit their results
+	// Last duration and result of each testcase by name, loaded from a 
+	// history file and updated by every result, once it's recording.
+	struct outcome {
+		long long duration; // nanoseconds
+		bool failed;
+	};
+	mutable std::map<std::string,outcome> m_history;
+	bool m_recording; // see 'record_history'
+	bool m_scheduling; // by history, once it's been loaded
+
+	// Enforces the timeouts of the policy, if any. On expiry, the results 
+	// of 'run' that are pending to keep their order are added first.
+	std::chrono::steady_clock::time_point m_started;
+	std::unique_ptr<watchdog> m_watchdog;
+	std::mutex m_pending_lock;
+	std::function<void()> m_pending;
+	std::atomic<bool> m_isolating; // global timeout enforced by run_isolated
+	std::ostream* m_output; // of the results on expiry
+
+	// Fixtures by name, and the ones that have been set up, in order of 
+	// their setup.
+	std::map<std::string,std::unique_ptr<fixture_state>> m_fixtures;
+	mutable std::mutex m_fixture_lock;
+	std::vector<fixture_state*> m_set_up;
+
+	// called by child testcases to submit their results, may be called 
+	// from any thread.
 	void add( log&& log );
+
+	// moves the submitted results into m_logs, in order of submission.
+	void drain() const;
+
+	// applies the policy to a new log.
+	void prepare( log& l );
+
+	// executes the body of a defined testcase, the results are written
+	// into the slot.
+	void execute( job& j, log& slot );
+
+	// expected durations of the jobs according to the history. Unknown
+	// ones are expected to take the mean duration.
+	std::vector<double> expected_durations( const std::vector<job>& jobs ) const;
+
+	// sorts the jobs by their history, see 'load_history'.
+	void schedule( std::vector<job>& jobs ) const;
+
+	// called by the watchdog: adds failed testcases (name, message), 
+	// flushes the results and terminates the process.
+	void expire( const std::vector<std::pair<std::string,std::string>>& f );
 public:
 	class testcase;
 	friend class testcase;
+	friend std::ostream& operator<<( std::ostream&, const testbench& );
 
 	// Constructor takes a descriptive, but otherwise irrelevant name.
 	testbench( const std::string& name );
+	testbench( const testbench& ) = delete;
+	~testbench();
+
+	// Sets the limits for testcases created afterwards.
+	void configure( const policy& p );
+
+	// The reporter receives the results of all testcases added after-
+	// wards, until 'finish' is called. It's not owned by the testbench.
+	void attach( reporter& r );
+
+	// Concludes and detaches all reporters.
+	void finish();
 
 	// Create a testcase with a name descriptive name (not an identifier).
+	// If the testbench is aborted, all checks of the testcase are skipped.
 	testcase create( const std::string& name );
 
+	// Define a testcase, that is not executed right away, but by 'run'.
+	// The body receives the testcase to perform its checks on.
+	void define( 
+		const std::string& name, 
+		std::function<void(testcase&)> body );
+
+	// Declares a fixture, which is shared by all testcases (see 
+	// 'testcase::fixture'). It's set up on first use, by calling 'setup'
+	// once, which returns the value. The value must be read-only then. 
+	// Fixtures are torn down by the destructor, in reverse order of their
+	// setup. Worker processes of 'run_isolated' inherit the ones set up 
+	// before, and set up the others themselves. Throws std::logic_error,
+	// if the name is already declared.
+	template <class Setup>
+	void fixture( const std::string& name, Setup setup );
+
+	// Defines all testcases registered by ELRAT_TESTCASE, in the order of 
+	// registration, and returns their number.
+	std::size_t define_registered();
+
+	// Runs the callable repeatedly and records the time per call, which is
+	// returned as well. Exceptions thrown by the callable are passed on.
+	template <class Callable>
+	benchmark measure( const std::string& name, Callable&& callable );
+
+	// Prevents the compiler from optimizing away the computation of a 
+	// value within a benchmark, that isn't used otherwise.
+	template <class T>
+	static void do_not_optimize( const T& value );
+
+	// Writes the samples of all benchmarks to a file. The file is 
+	// replaced only after it's been written completely.
+	void save_baseline( const std::string& path ) const;
+
+	// Compares the benchmarks against the ones from a baseline file, using
+	// a one-sided Mann-Whitney U test. Each comparison is added as a 
+	// testcase, that fails if the benchmark became significantly slower.
+	// Benchmarks without baseline are skipped. Returns the number of 
+	// comparisons.
+	int compare_baseline( const std::string& path );
+
+	// Reads the durations and results of testcases from a file written
+	// by 'save_history', if it exists. 'run' and 'run_isolated' then 
+	// execute the testcases that failed last time first, and the others
+	// longest-first. Starts recording, see 'record_history'.
+	void load_history( const std::string& path );
+
+	// Records the duration and result of the testcases added afterwards,
+	// for 'save_history'. Otherwise they're not kept, so that the memory
+	// doesn't grow with the number of testcases.
+	void record_history();
+
+	// Writes the last duration and result of every testcase recorded so 
+	// far, including the loaded ones. The file is replaced only after it's 
+	// been written completely.
+	void save_history( const std::string& path ) const;
+
+	// Executes all defined testcases on the given number of threads
+	// (0: one per hardware thread) and removes them from the list.
+	// The results are added in the order the testcases have been 
+	// defined (or scheduled by the history), regardless of the order 
+	// they finished.
+	void run( unsigned threads = 1 );
+
+	// Like 'run', but each testcase is executed by one of the given number
+	// of worker processes (0: one per hardware thread), which are forked
+	// in advance. If a worker crashes or exceeds the timeout of the 
+	// policy, the testcase fails and the worker is replaced. Must not be 
+	// called while other threads are running. Without fork() it's the 
+	// same as 'run'.
+	void run_isolated( unsigned workers = 0 );
+
+	// Command line interface to run the defined testcases, which prints 
+	// the results and returns the exit code (0: passed, 1: failed, 2: 
+	// invalid arguments). Options:
+	// 	--list                 print the names of the selected testcases
+	// 	--filter=<glob>        select names matching the pattern ('*','?')
+	// 	--regex=<regex>        select names containing a match
+	// 	--shard-index=<i>      select the i-th of ...
+	// 	--shard-count=<n>      ... n shards of the remaining testcases
+	// 	--history=<file>       durations and results of previous runs, 
+	// 	                       which balance the shards and order the 
+	// 	                       testcases (see 'load_history'). It's 
+	// 	                       only read.
+	// 	--save-history=<file>  writes the history after the run, 
+	// 	                       including the one read (see 
+	// 	                       'save_history'). It may be the same file 
+	// 	                       as '--history', unless it's shared by 
+	// 	                       jobs, which then might see different 
+	// 	                       shards.
+	// 	--threads=<n>          see 'run'
+	// 	--isolate              see 'run_isolated'
+	// 	--update-goldens       see 'policy::update_goldens'
+	// The shards are the same for all jobs with the same arguments and 
+	// contents of the history file.
+	int main( int argc, char* argv[], std::ostream& os = std::cout );
+
 	// 'getter'
 	const std::string& name() const;
+	const policy& configuration() const;
+	bool aborted() const; // limit of failed testcases has been reached
+	std::size_t dropped_messages() const; // exceeding the memory limit
+	counts totals() const; // all counts, consistent with each other
 	int testcases() const;
 	int checks() const;
 	int failed_testcases() const;
 	int failed_checks() const;
+
+	// The reference remains valid, as long as no other thread is querying
+	// the testbench at the same time.
 	const std::vector<log>& logs() const;
+
+	// copy of the benchmarks, since they may be measured concurrently
+	std::vector<benchmark> benchmarks() const;
+
+	// Testcases with the longest wall time, in descending order. The 
+	// number is set by the policy.
+	std::vector<std::pair<std::string,resources>> slowest() const;
+
+	// Fixtures that have been set up, with their setup time, in order of
+	// their setup.
+	std::vector<std::pair<std::string,std::chrono::nanoseconds>> 
+	fixtures() const;
+};
+
+// Receives the results of testcases as they're added to the testbench. 
+// The calls are serialized, but they may come from any thread. 
+class testbench::reporter {
+public:
+	virtual ~reporter();
+	virtual void begin( const testbench& tb );
+	virtual void report( const testbench& tb, const log& l ) = 0;
+	virtual void end( const testbench& tb );
+};
+
+// Writes one JSON object per line and testcase, and a final line with the
+// totals.
+class testbench::json_lines_reporter : public reporter {
+private:
+	std::ostream& m_os;
+public:
+	json_lines_reporter( std::ostream& os );
+	void report( const testbench& tb, const log& l ) override;
+	void end( const testbench& tb ) override;
+};
+
+// Writes a JUnit XML test suite. Since the results are streamed, the suite
+// is written without the count attributes.
+class testbench::junit_reporter : public reporter {
+private:
+	std::ostream& m_os;
+public:
+	junit_reporter( std::ostream& os );
+	void begin( const testbench& tb ) override;
+	void report( const testbench& tb, const log& l ) override;
+	void end( const testbench& tb ) override;
+};
+
+// Testcase registered by ELRAT_TESTCASE. Registrations are static objects,
+// which link themselves into a list during static initialization, so the
+// registry costs nothing but the link of each one. Within a translation 
+// unit, they're listed in the order of their definition, while the order of
+// the translation units is unspecified.
+class testbench::registration {
+public:
+	typedef void (*function)( testcase& );
+
+	registration( const char* name, function body );
+	registration( const registration& ) = delete;
+
+	const char* name() const;
+	function body() const;
+
+	// next registration, or nullptr
+	const registration* next() const;
+
+	// first registration, or nullptr
+	static const registration* first();
+private:
+	const char* m_name;
+	function m_body;
+	registration* m_next;
+
+	struct list {
+		registration* first;
+		registration* last;
+	};
+	static list& registry();
+};
+
+// Result of 'testbench::measure'. All times in nanoseconds per call.
+struct testbench::benchmark {
+	benchmark( const std::string& name, std::vector<double>&& samples );
+	std::string name;
+	long long iterations; // per sample
+	std::vector<double> samples;
+	double mean;
+	double median;
+	double stddev;
+	double min;
+	double max;
 };
 
 struct testbench::log {
@@ -59,18 +571,179 @@ struct testbench::log {
 	log( const std::string& name );
 	log( const log& ) = delete;
 	log( log&& ) = default;
+	log& operator=( log&& ) = default;
+	// A passing check doesn't allocate. A failed check copies the message
+	// into the pool, so literals are passed without a temporary string.
 	void add( bool failed, const std::string& msg );
+	void add( bool failed, const char* msg );
+	void add( bool failed, const char* msg, std::size_t size );
+
+	// Counts a passing check, see ELRAT_TESTBENCH_CHECKS.
+	void pass();
+
+	// false, if the next failed check won't be recorded with its message.
+	bool recording() const;
+
+	arena* pool; // stores the messages of the entries
+	std::unique_ptr<arena> own_pool; // if logs are not retained
 	std::string name;
 	int check_count;
+	int failed_count; // might exceed the number of entries
+	bool aborted;
 	std::vector<entry> entries;
+	resources used;
+
+	// limits, taken from the policy of the testbench.
+	int max_failed_checks;
+	int max_entries;
+};
+
+struct testbench::submission {
+	submission( log&& l );
+	log result;
+	submission* next;
+};
+
+struct testbench::job {
+	job( const std::string& name, std::function<void(testcase&)>&& body );
+	std::string name;
+	std::function<void(testcase&)> body;
+};
+
+struct testbench::fixture_state {
+	fixture_state( 
+		const std::string& name, 
+		const std::type_info& type,
+		std::function<std::shared_ptr<void>()>&& setup );
+	std::string name;
+	const std::type_info& type;
+	std::function<std::shared_ptr<void>()> setup;
+	std::once_flag once;
+	std::shared_ptr<void> value;
+	std::chrono::nanoseconds setup_time;
+};
+
+// Distributes job indices among the worker queues. A worker takes jobs from
+// the front of its own queue, and if that one's empty, steals from the back 
+// of the others.
+class testbench::scheduler {
+private:
+	struct queue {
+		std::mutex lock;
+		std::deque<std::size_t> jobs;
+	};
+	std::vector<std::unique_ptr<queue>> m_queues;
+public:
+	scheduler( std::size_t workers, std::size_t jobs );
+	bool pop( std::size_t worker, std::size_t& job );
+};
+
+// Stores the messages of failed checks in chunks of up to 64 KiB, instead 
+// of a string per message. With a limit set, either new messages are rejected or the 
+// oldest chunks are released.
+class testbench::arena {
+public:
+	// Location of a stored message.
+	struct text {
+		text();
+		std::size_t chunk;
+		const char* data;
+		std::size_t size;
+	};
+
+	arena();
+	arena( const arena& ) = delete;
+
+	// bytes - 0: no limit
+	void limit( std::size_t bytes, bool drop_oldest );
+
+	// false, if new messages are rejected.
+	bool accepting() const;
+
+	// Returns false, if the message has been dropped. Once not accepting
+	// anymore, every call counts as a dropped message.
+	bool store( const std::string& s, text& t );
+	bool store( const char* s, std::size_t size, text& t );
+
+	std::string read( const text& t ) const;
+	std::size_t dropped() const;
+private:
+	struct chunk {
+		std::unique_ptr<char[]> data;
+		std::size_t capacity;
+		std::size_t used;
+		std::size_t messages;
+	};
+	static const std::size_t ChunkSize = 64 * 1024;
+
+	mutable std::mutex m_lock;
+	std::deque<chunk> m_chunks;
+	std::size_t m_first; // index of the front chunk
+	std::size_t m_bytes; // allocated by all chunks
+	std::size_t m_limit;
+	bool m_drop_oldest;
+	std::atomic<bool> m_full;
+	std::size_t m_dropped;
+};
+
+// Read-only view of a file. On POSIX systems the file is memory-mapped, 
+// otherwise (or if that fails) the requested part is read into a buffer.
+class testbench::mapping {
+public:
+	mapping( const std::string& path );
+	mapping( const mapping& ) = delete;
+	~mapping();
+
+	bool is_open() const;
+	std::size_t size() const;
+
+	// Bytes [offset,offset+n) of the file, which must be within its size.
+	// The pointer is valid until the next call.
+	const char* view( std::size_t offset, std::size_t n );
+private:
+	bool m_open;
+	std::size_t m_size;
+	const char* m_data; // mapped, if not nullptr
+	std::ifstream m_file;
+	std::vector<char> m_buffer;
+};
+
+// Thread, that checks the running testcases against the timeouts. 
+// Testcases are watched from construction to destruction.
+class testbench::watchdog {
+private:
+	typedef std::chrono::steady_clock clock;
+	struct watched {
+		std::uint64_t id;
+		std::string name;
+		clock::time_point start;
+	};
+	testbench& m_tb;
+	const std::chrono::milliseconds m_testcase_timeout;
+	const std::chrono::milliseconds m_global_timeout;
+	std::mutex m_lock;
+	std::condition_variable m_wake;
+	bool m_stop;
+	std::uint64_t m_next;
+	std::vector<watched> m_watched;
+	std::thread m_thread;
+
+	void loop();
+public:
+	watchdog( testbench& tb, const policy& p );
+	~watchdog();
+	std::uint64_t watch( const std::string& name );
+	void unwatch( std::uint64_t id );
 };
 
 struct testbench::log::entry {
-	entry( int pos, std::string msg="" );
+	entry( int pos, const arena* pool, const arena::text& msg );
 	entry( const entry& ) = delete;
 	entry( entry&& ) = default;
+	std::string message() const;
 	int position;
-	std::string message;
+	const arena* pool;
+	arena::text text;
 };
 
 class testbench::testcase {
@@ -82,30 +755,93 @@ private:
 	// private data member
 	log m_log;
 	testbench* m_parent;
+	log* m_slot;
+	std::uint64_t m_watch; // by the watchdog of the parent, if not 0
+
+	// resources at the time of creation
+	std::chrono::steady_clock::time_point m_start;
+	std::chrono::nanoseconds m_cpu_start;
+	allocations m_allocations_start;
 
 	// private function member 
 	
-	// constructor, invoked by the parent testbench.
-	testcase( const std::string& name, testbench* parent );
+	// constructor, invoked by the parent testbench. If 'slot' is set, the
+	// results are written there instead of being added to the parent.
+	testcase( 
+		const std::string& name, 
+		testbench* parent, 
+		log* slot = nullptr );
 
 	// This private function is used to encapsulate comparison operations 
 	// in a try-catch-block.0 While this is not necessary for primitive 
 	// data types, the application programmer might have own overloads, 
 	// which are not necessarily guaranteed to nothrow.
-	template <class Callable>
-	void nothrow_cmp( std::string&& s, Callable&& c );
+	// The feedback message is only created if the comparison fails.
+	template <class Compare, class Message>
+	void nothrow_cmp( Compare&& c, Message&& m );
+
+	// Checks n elements at once, which is recorded as a single check. 
+	// 'mismatch' takes an index and returns true, if the element doesn't
+	// meet the requirement. The mismatches are counted in blocks, which
+	// the compiler can vectorize for arithmetic types, and only the first 
+	// ones are described, if the check fails.
+	template <class Mismatch, class Header, class Describe>
+	void bulk_cmp( 
+		std::size_t n, 
+		Mismatch&& mismatch, 
+		Header&& header, 
+		Describe&& describe );
+
+	// Checks if all pairs a[i], b[i] are near to each other according to
+	// 'apart', after checking if a and b have the same size.
+	template <class Container1, class Container2, class Apart, class Header>
+	void bulk_near( 
+		const Container1& a, 
+		const Container2& b, 
+		Apart&& apart, 
+		Header&& header );
+
+	// Splits the arguments of 'for_all' into generators and property.
+	template <std::size_t...> 
+	struct indices {};
+
+	template <std::size_t N, std::size_t...Is> 
+	struct make_indices : make_indices<N - 1, N - 1, Is...> {};
+
+	template <std::size_t...Is> 
+	struct make_indices<0, Is...> {
+		typedef indices<Is...> type;
+	};
+
+	template <class Tuple, std::size_t...Is>
+	void for_all_impl( Tuple&& t, indices<Is...> );
+
+	// Generates the values of a case and returns true, if they falsify
+	// the property. The message of an exception is stored in 'error'.
+	template <class Tuple, class Values, std::size_t...Is>
+	static bool falsifies( 
+		Tuple& t, 
+		source& src, 
+		Values& values, 
+		std::string& error, 
+		indices<Is...> );
 public:
 	// Deleted copy constructor, because on when a testcase goes out of 
 	// scope, it'll report back to the parent testbench, which shall occur 
 	// only once...
 	testcase( const testcase& ) = delete; 
 
-	// ... Instead the object will be moved around if necessary.
-	testcase( testcase&& ) = default;
+	// ... Instead the object will be moved around if necessary. The 
+	// moved-from object doesn't report anything.
+	testcase( testcase&& );
 
 	// Adds its test results to the parent testbench.
 	~testcase();
 
+	// true, if further checks are skipped, because too many checks failed
+	// already or the parent testbench had been aborted.
+	bool aborted() const;
+
 	// Requires T to be implicitely convertible to bool
 	template <class T> 
 	void check( const T& );
@@ -120,10 +856,26 @@ public:
 	void equal( const T& a, const T& b );
 	
 	// Requires overloaded operator< 
-	// Checks if a is in range [b-th,b+th]
+	// Checks if a is in range [b-th,b+th], fails if a or b is NaN
 	template <class T> 
 	void equal( const T& a, const T& b, const T& th ); 
 
+	// The following members require T to be float or double. NaN is never
+	// near any value, but equal infinities are near to each other.
+
+	// Checks if a and b are at most 'ulps' representable values apart.
+	template <class T> 
+	void near_ulps( T a, T b, std::uint64_t ulps );
+
+	// Checks if |a-b| <= rel * max(|a|,|b|)
+	template <class T> 
+	void near_relative( T a, T b, T rel );
+
+	// Checks if |a-b| <= max(abs, rel * max(|a|,|b|)), i.e. the absolute 
+	// threshold is used near zero, where relative errors are meaningless.
+	template <class T> 
+	void near( T a, T b, T abs, T rel );
+
 	// Requires overloaded operator< 
 	template <class T> 
 	void less_than( const T& a, const T& b );
@@ -168,8 +920,175 @@ public:
 	template <class Exception, class Callable> 
 	void throws( Callable&& callable );
 
+	// Must not throw and must return within the given duration.
+	template <class Rep, class Period, class Callable> 
+	void completes_within( 
+		const std::chrono::duration<Rep,Period>& budget, 
+		Callable&& callable );
+
+	// Must not throw and must not allocate more than the given number of
+	// bytes on the heap (of the calling thread). Requires allocation 
+	// tracking, see 'testbench::allocations'.
+	template <class Callable> 
+	void allocates_at_most( long long bytes, Callable&& callable );
+
+	// Checks of whole ranges, which count as a single check. The 
+	// iterators must be random access iterators, e.g. pointers. If the
+	// check fails, the first mismatching elements are reported with their
+	// index (see 'policy::max_mismatches').
+
+	// Requires overloaded operator==
+	template <class Iterator1, class Iterator2>
+	void equal_range( Iterator1 first1, Iterator1 last1, Iterator2 first2 );
+
+	// Requires overloaded operator>= and operator<=
+	template <class Iterator, class T>
+	void all_in_range( Iterator first, Iterator last, const T& lo, const T& hi );
+
+	template <class Container, class T>
+	void all_in_range( const Container& c, const T& lo, const T& hi );
+
+	// Checks if a[i] is in range [b[i]-th,b[i]+th], requires the same size
+	// and overloaded operator-, operator<= and operator>
+	template <class Container1, class Container2, class T>
+	void all_near( const Container1& a, const Container2& b, const T& th );
+
+	// Range versions of near_ulps, near_relative and near
+	template <class Container1, class Container2>
+	void all_near_ulps( 
+		const Container1& a, 
+		const Container2& b, 
+		std::uint64_t ulps );
+
+	template <class Container1, class Container2, class T>
+	void all_near_relative( const Container1& a, const Container2& b, T rel );
+
+	template <class Container1, class Container2, class T>
+	void all_near( const Container1& a, const Container2& b, T abs, T rel );
+
+	// Checks a property with values of the generators, e.g.
+	// 	t.for_all( 
+	// 		testbench::integers<int>(), 
+	// 		testbench::strings(),
+	// 		[]( int i, const std::string& s ) { return ...; } );
+	// The property must return true for all the cases, which count as a
+	// single check. A falsifying case is shrunk to a minimal counterexample
+	// (requires overloaded operator<<). The values are kept between cases, 
+	// so that their memory is reused (see 'policy::property_cases').
+	// If the cases are split into shards, the first counterexample found
+	// cancels the other shards.
+	template <class...Args>
+	void for_all( Args&&... args );
+
+	// Compares the bytes against a golden file (see 'policy::
+	// golden_directory'), which is memory-mapped and compared in chunks.
+	// If they differ, the first differing offset is reported with the 
+	// bytes around it. In update mode ('policy::update_goldens'), the 
+	// golden file is replaced by the bytes instead, and the check passes. 
+	// It's written to a temporary file first, which is then renamed.
+	void matches_golden( 
+		const std::string& name, 
+		const void* data, 
+		std::size_t size );
+
+	// Contiguous bytes, e.g. std::string or std::vector<char>
+	template <class Bytes>
+	void matches_golden( const std::string& name, const Bytes& bytes );
+
+	// Value of a fixture of the parent testbench, see 'testbench::fixture'.
+	// If it's not set up yet, it's set up by the calling thread, while 
+	// other testcases using it wait. Exceptions thrown by the setup are 
+	// passed on, and the next use tries again. Throws std::logic_error, if 
+	// no fixture of that name and type is declared.
+	template <class T>
+	const T& fixture( const std::string& name );
+
 }; 
 
+// Reproducible sequence of choices (xoshiro256**), from which generators
+// draw their values. Smaller choices must map to simpler values, since 
+// counterexamples are shrunk by replaying smaller choices.
+class testbench::source {
+private:
+	friend class testcase;
+	std::uint64_t m_state[4];
+	const std::vector<std::uint64_t>* m_prefix; // replayed, if not null
+	std::vector<std::uint64_t> m_choices; // of the current case
+
+	std::uint64_t next();
+
+	// starts a new case with random choices
+	void generate();
+
+	// starts a new case with the given choices, followed by zeros.
+	void replay( const std::vector<std::uint64_t>& prefix );
+public:
+	explicit source( std::uint64_t seed );
+
+	// Returns a choice in range [0,bound].
+	std::uint64_t draw( std::uint64_t bound );
+};
+
+// Integers in range [lo,hi], shrinking towards zero.
+template <class T>
+class testbench::integers {
+private:
+	static_assert( std::is_integral<T>::value 
+		&& !std::is_same<T,bool>::value, "Requires an integral type" );
+	T m_lo;
+	T m_hi;
+public:
+	typedef T value_type;
+	integers( 
+		T lo = std::numeric_limits<T>::min(), 
+		T hi = std::numeric_limits<T>::max() );
+	void operator()( source& s, T& out ) const;
+};
+
+// Finite floating-point values in range [lo,hi], shrinking towards zero.
+template <class T>
+class testbench::floats {
+private:
+	static_assert( std::is_floating_point<T>::value, 
+		"Requires a floating-point type" );
+	T m_lo;
+	T m_hi;
+public:
+	typedef T value_type;
+	floats( 
+		T lo = -std::numeric_limits<T>::max(), 
+		T hi = std::numeric_limits<T>::max() );
+	void operator()( source& s, T& out ) const;
+};
+
+// Strings of characters of the alphabet, shrinking towards shorter ones
+// and the first characters of the alphabet.
+class testbench::strings {
+private:
+	std::size_t m_max_length;
+	std::string m_alphabet;
+public:
+	typedef std::string value_type;
+	strings( 
+		std::size_t max_length = 32, 
+		const std::string& alphabet = 
+			"abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ"
+			"0123456789 !\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~" );
+	void operator()( source& s, std::string& out ) const;
+};
+
+// Vectors of values of another generator, shrinking towards shorter ones.
+template <class Generator>
+class testbench::vectors {
+private:
+	Generator m_element;
+	std::size_t m_max_size;
+public:
+	typedef std::vector<typename Generator::value_type> value_type;
+	vectors( const Generator& g, std::size_t max_size = 32 );
+	void operator()( source& s, value_type& out ) const;
+};
+
 // Utility function to create detailed error/failed message.
 // Example: 
 // 	std::string msg = intern::concatenate(
@@ -180,15 +1099,150 @@ public:
 // 		"], but should be over ",
 // 		9000,
 // 		"!" );
+// The message is assembled in a buffer of the thread, which is reused.
+// Strings, integers and floating-point values (as "%g") are converted 
+// directly, all other types are written with their operator<<.
 struct testbench::intern {
-	template <class Arg, class...Args> 
-	static std::string write_to_stream( std::stringstream&, Arg, Args... );
-	
-	template <class Arg> 
-	static std::string write_to_stream( std::stringstream&, Arg );
-	
 	template <class...Args> 
-	static std::string concatenate( Args...args );
+	static std::string concatenate( const Args&... args );
+
+	// Same as concatenate, but the arguments replace the placeholders "{}"
+	// of the format string (see ELRAT_TESTBENCH_FORMAT).
+	template <std::size_t N> 
+	struct arity {};
+
+	static constexpr std::size_t placeholders( 
+		const char* fmt, 
+		std::size_t n = 0 ) 
+	{
+		return !*fmt ? n 
+			: ( fmt[0] == '{' && fmt[1] == '}' ) 
+				? placeholders( fmt + 2, n + 1 ) 
+				: placeholders( fmt + 1, n );
+	}
+
+	template <std::size_t N, class...Args> 
+	static std::string format( 
+		arity<N>, 
+		const char* fmt, 
+		const Args&... args );
+
+	// Appends a value to the string, dispatched by the kind of type.
+	template <int Kind> 
+	struct kind {};
+
+	template <class T> 
+	static void append( std::string& out, const T& t );
+	static void append( std::string& out, bool b, kind<0> );
+	static void append( std::string& out, char c, kind<1> );
+	template <class T> 
+	static void append( std::string& out, T t, kind<2> ); // integer
+	template <class T> 
+	static void append( std::string& out, T t, kind<3> ); // floating-point
+	static void append( std::string& out, const char* s, kind<4> );
+	static void append( std::string& out, const std::string& s, kind<5> );
+	template <class T> 
+	static void append( std::string& out, const T& t, kind<6> ); // other
+	
+	// returns the buffer of the calling thread, which is taken by the
+	// caller and has to be given back, so that nested calls don't share it.
+	static std::string& thread_buffer();
+	static std::string take_buffer();
+	static std::string give_back( std::string& buffer );
+
+	// Escapes a string to be used within JSON quotes, or an XML attribute
+	static std::string json_escape( const std::string& s );
+	static std::string xml_escape( const std::string& s );
+
+	// Binary representation of a log, prefixed by its length, to be sent
+	// from a worker process to the parent.
+	static void serialize( const log& l, std::string& out );
+	static bool deserialize( const std::string& in, log& l );
+
+	// Blocking reads and writes of a file descriptor, which return false
+	// if the other end has been closed.
+	static bool read_all( int fd, void* data, std::size_t size );
+	static bool write_all( int fd, const void* data, std::size_t size );
+
+	// CPU time consumed by the calling thread.
+	static std::chrono::nanoseconds thread_cpu_time();
+
+	// Shrinks a falsifying sequence of choices. 'fails' replays a candidate
+	// and returns true if it still falsifies the property, along with the
+	// choices actually used. Returns the number of successful steps.
+	template <class Fails>
+	static std::size_t shrink( 
+		std::vector<std::uint64_t>& choices, 
+		Fails&& fails, 
+		int attempts );
+
+	// Seed of the cases of a testcase.
+	static std::uint64_t seed( std::uint64_t seed, const std::string& name );
+
+	// Writes a value of a counterexample.
+	template <class T>
+	static void print( std::ostream& os, const T& t );
+	static void print( std::ostream& os, const std::string& s );
+	template <class T>
+	static void print( std::ostream& os, const std::vector<T>& v );
+
+	// True for NaN, false for any other value or non-floating-point type
+	template <class T> 
+	static bool is_nan( const T& t );
+
+	// Number of representable values between a and b, or the maximum 
+	// value if a or b is NaN (which must be checked separately, anyway).
+	// Requires float or double.
+	template <class T> 
+	static std::uint64_t ulps( T a, T b );
+
+	// Relative and combined deviation checks, which fail on NaN.
+	template <class T> 
+	static bool near_relative( T a, T b, T rel );
+
+	template <class T> 
+	static bool near( T a, T b, T abs, T rel );
+
+	// Human-readable duration, e.g. "1.25 ms"
+	static std::string duration( std::chrono::nanoseconds ns );
+
+	// Hexadecimal bytes, with the one at 'mark' in parentheses, e.g. 
+	// "0a (ff) 1b"
+	static std::string hex( const char* p, std::size_t n, std::size_t mark );
+
+	// Writes a file completely to a temporary file, which then replaces
+	// the file. Returns false, if that fails.
+	static bool replace_file( 
+		const std::string& path, 
+		const char* data, 
+		std::size_t size );
+
+	// True, if the environment variable is set and not "0".
+	static bool enabled( const char* variable );
+
+	// p-value of the hypothesis, that the values of 'a' tend to be 
+	// greater than those of 'b'.
+	static double mann_whitney( 
+		const std::vector<double>& a, 
+		const std::vector<double>& b );
+
+	// True, if the whole string matches the pattern, in which '*' matches
+	// any sequence and '?' any single character.
+	static bool glob( const std::string& pattern, const std::string& s );
+
+	// Indices of the items of the given shard. The items are assigned 
+	// longest-first to the shard with the least total weight.
+	static std::vector<std::size_t> shard( 
+		const std::vector<double>& weights, 
+		std::size_t count, 
+		std::size_t index );
+
+	// History file, see 'testbench::load_history'
+	static std::map<std::string,outcome> load_history( 
+		const std::string& path );
+	static void save_history( 
+		const std::string& path, 
+		const std::map<std::string,outcome>& history );
 };
 
 
@@ -197,371 +1251,3250 @@ struct testbench::intern {
 //
 // testbench
 //
-testbench::testbench( const std::string& name ) 
-: m_name{name} {
+inline testbench::testbench( const std::string& name ) 
+: m_name{name}
+, m_failed_submissions{0}
+, m_arena{new arena}
+, m_reporting{false}
+, m_submitted{nullptr}
+, m_dropped{0}
+, m_recording{false}
+, m_scheduling{false}
+, m_started{ std::chrono::steady_clock::now() }
+, m_isolating{false}
+, m_output{ &std::cout } {
+
+}
 
+inline testbench::~testbench() {
+	for( auto i = m_set_up.rbegin(); i != m_set_up.rend(); i++ ) 
+		(*i)->value.reset();
+	m_watchdog.reset();
+	submission* s = m_submitted.exchange( nullptr );
+	while( s ) {
+		submission* next = s->next;
+		delete s;
+		s = next;
+	}
 }
 
-const std::string& testbench::name() const {
+inline const std::string& testbench::name() const {
 	return m_name;
 }
 
-testbench::testcase testbench::create( const std::string& name ) {
-	return testcase(name,this);
+inline void testbench::configure( const policy& p ) {
+	m_policy = p;
+	m_arena->limit( p.max_message_bytes, p.drop_oldest_messages );
+	m_watchdog.reset();
+	if ( p.testcase_timeout.count() || p.global_timeout.count() )
+		m_watchdog.reset( new watchdog( *this, p ) );
 }
 
-int testbench::testcases() const {
-	return m_logs.size();
+inline const testbench::policy& testbench::configuration() const {
+	return m_policy;
 }
 
-int testbench::failed_testcases() const {
-	int result{0};
-	for(auto& l : m_logs) {
-		if ( l.entries.size() )
-			result++;
-	}
-	return result;
+inline bool testbench::aborted() const {
+	return m_policy.max_failed_testcases 
+		&& m_failed_submissions.load() >= m_policy.max_failed_testcases;
 }
 
-int testbench::checks() const {
-	int result{0};
-	for( auto& l : m_logs ) {
-		result += l.check_count;
-	}
-	return result;
+inline std::size_t testbench::dropped_messages() const {
+	drain();
+	std::lock_guard<std::mutex> guard( m_drain );
+	return m_arena->dropped() + m_dropped;
 }
 
-int testbench::failed_checks() const {
-	int result{0};
-	for(auto& l : m_logs) {
-		result += l.entries.size();	
-	}
-	return result;
+inline void testbench::attach( reporter& r ) {
+	std::lock_guard<std::mutex> guard( m_report_lock );
+	r.begin( *this );
+	m_reporters.push_back( &r );
+	m_reporting = true;
 }
 
-const std::vector<testbench::log>& testbench::logs() const {
-	return m_logs;
+inline void testbench::finish() {
+	std::lock_guard<std::mutex> guard( m_report_lock );
+	m_reporting = false;
+	for( auto r : m_reporters )
+		r->end( *this );
+	m_reporters.clear();
 }
 
-void testbench::add( testbench::log&& l ) {
-	m_logs.push_back( std::move(l) );
+inline testbench::testcase testbench::create( const std::string& name ) {
+	return testcase(name,this);
 }
 
-//
-// testbench::testcase
-//
+inline testbench::counts testbench::totals() const {
+	drain();
+	std::lock_guard<std::mutex> guard( m_drain );
+	return m_counts;
+}
 
-// s - If the operation threw an exception, the corresponding message is 
-//     written back.
-// c - The callable, that's performing the comparison and returns a bool.
-template <class Callable>
-void testbench::testcase::nothrow_cmp( std::string&& s, Callable&& c ) {
-	std::string msg = std::move(s);
-	bool op_result;
-	bool success{false};
-	try {
-		op_result = c();
-		success = true;
-	} 
-	catch( std::exception& e ) {
-		msg = intern::concatenate(
-			"std::exception: [",
-			e.what(),
-			"]");
-	}
-	catch( ... ) {
-		msg = std::string("exception (unknown type).");
-	}	
-	m_log.add( !success || !op_result, msg );
+inline int testbench::testcases() const {
+	return totals().testcases;
+}
 
+inline int testbench::failed_testcases() const {
+	return totals().failed_testcases;
 }
 
+inline int testbench::checks() const {
+	return totals().checks;
+}
 
+inline int testbench::failed_checks() const {
+	return totals().failed_checks;
+}
 
-testbench::testcase::testcase( const std::string& name, testbench* parent ) 
-: m_log(name), m_parent{parent} {
-	
+inline std::vector<std::pair<std::string,testbench::resources>> 
+testbench::slowest() const {
+	drain();
+	std::lock_guard<std::mutex> guard( m_drain );
+	return m_slowest;
 }
 
-testbench::testcase::~testcase() {
-	m_parent->add( std::move(m_log) );
+inline std::vector<testbench::benchmark> testbench::benchmarks() const {
+	std::lock_guard<std::mutex> guard( m_benchmark_lock );
+	return m_benchmarks;
 }
 
-template <class T>
-void testbench::testcase::check( const T& t ) {
-	m_log.add( !static_cast<bool>(t), "Expression evaluated to 'false'.");
+inline std::vector<std::pair<std::string,std::chrono::nanoseconds>> 
+testbench::fixtures() const {
+	std::lock_guard<std::mutex> guard( m_fixture_lock );
+	std::vector<std::pair<std::string,std::chrono::nanoseconds>> f;
+	for( auto s : m_set_up ) 
+		f.push_back( std::make_pair( s->name, s->setup_time ) );
+	return f;
 }
 
-template <class T>
-void testbench::testcase::equal( const T& a, const T& b ) {
-	nothrow_cmp( 
-		intern::concatenate("Expected [",b, "], but found [",a, "]."),
+inline const std::vector<testbench::log>& testbench::logs() const {
+	drain();
+	return m_logs;
+}
+
+inline void testbench::add( testbench::log&& l ) {
+	if ( l.failed_count )
+		m_failed_submissions++;
+	if ( m_reporting.load( std::memory_order_relaxed ) ) {
+		std::lock_guard<std::mutex> guard( m_report_lock );
+		for( auto r : m_reporters )
+			r->report( *this, l );
+	}
+	submission* s = new submission( std::move(l) );
+	s->next = m_submitted.load( std::memory_order_relaxed );
+	while( !m_submitted.compare_exchange_weak( 
+		s->next, 
+		s,
+		std::memory_order_release,
+		std::memory_order_relaxed ) );
+}
+
+inline void testbench::drain() const {
+	std::lock_guard<std::mutex> guard( m_drain );
+	submission* s = m_submitted.exchange( nullptr, std::memory_order_acquire );
+
+	// The stack holds the latest submission on top, so it's reversed 
+	// first.
+	submission* reversed{nullptr};
+	while( s ) {
+		submission* next = s->next;
+		s->next = reversed;
+		reversed = s;
+		s = next;
+	}
+	while( reversed ) {
+		submission* next = reversed->next;
+		log& l = reversed->result;
+		m_counts.testcases++;
+		m_counts.checks += l.check_count;
+		m_counts.failed_checks += l.failed_count;
+		if ( l.failed_count )
+			m_counts.failed_testcases++;
+		const int slowest = m_policy.slowest_testcases;
+		if ( slowest > 0 && ( static_cast<int>(m_slowest.size()) < slowest 
+			|| l.used.wall_time > m_slowest.back().second.wall_time ) ) 
+		{
+			auto pos = std::find_if( m_slowest.begin(), m_slowest.end(), 
+				[&l]( const std::pair<std::string,resources>& x ) { 
+					return l.used.wall_time > x.second.wall_time; 
+				});
+			m_slowest.insert( pos, std::make_pair( l.name, l.used ) );
+			if ( static_cast<int>(m_slowest.size()) > slowest ) 
+				m_slowest.pop_back();
+		}
+		if ( m_recording ) {
+			outcome& o = m_history[ l.name ];
+			o.duration = l.used.wall_time.count();
+			o.failed = l.failed_count > 0;
+		}
+		if ( l.own_pool )
+			m_dropped += l.own_pool->dropped();
+		else
+			m_logs.push_back( std::move(l) );
+		delete reversed;
+		reversed = next;
+	}
+}
+
+template <class Callable>
+testbench::benchmark testbench::measure( 
+	const std::string& name, 
+	Callable&& callable ) 
+{
+	typedef std::chrono::steady_clock clock;
+	auto batch = [&]( long long n ) {
+		auto start = clock::now();
+		for( long long i{0}; i < n; i++ )
+			callable();
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			clock::now() - start );
+	};
+	const std::chrono::nanoseconds target{ m_policy.sample_time };
+	// The upper bound prevents an overflow, when the compiler optimized 
+	// the loop away.
+	const long long max_iterations{ 1000000000 };
+	long long n{1};
+	for( auto elapsed = batch( n ); 
+		elapsed < target && n < max_iterations; 
+		elapsed = batch( n ) ) 
+	{
+		// Aim a little higher than the target, but don't grow by more 
+		// than a factor of 100 at once, since the first batches are 
+		// dominated by cold caches.
+		double factor = elapsed.count() 
+			? 1.2 * target.count() / elapsed.count() 
+			: 100.0;
+		factor = std::min( 100.0, std::max( 2.0, factor ) );
+		n = std::min( max_iterations, static_cast<long long>( n * factor ) );
+	}
+	std::vector<double> samples;
+	for( int i{0}; i < std::max( 1, m_policy.samples ); i++ ) 
+		samples.push_back( static_cast<double>( batch( n ).count() ) / n );
+	benchmark b( name, std::move(samples) );
+	b.iterations = n;
+	std::lock_guard<std::mutex> guard( m_benchmark_lock );
+	m_benchmarks.push_back( b );
+	return b;
+}
+
+template <class T>
+void testbench::do_not_optimize( const T& value ) {
+#if defined(__GNUC__) || defined(__clang__)
+	asm volatile( "" : : "r,m"(value) : "memory" );
+#else
+	static thread_local const volatile void* sink;
+	sink = &value;
+#endif
+}
+
+inline void testbench::save_baseline( const std::string& path ) const {
+	const std::string temporary( path + ".tmp" );
+	{
+		std::ofstream file( temporary.c_str() );
+		if ( !file )
+			throw std::runtime_error( "Cannot write " + temporary );
+		file.precision( 17 );
+
+		// <sample count> <samples...> <name until end of line>
+		std::lock_guard<std::mutex> guard( m_benchmark_lock );
+		for( auto& b : m_benchmarks ) {
+			file << b.samples.size();
+			for( auto x : b.samples )
+				file << ' ' << x;
+			std::string name( b.name );
+			std::replace( name.begin(), name.end(), '\n', ' ' );
+			file << ' ' << name << '\n';
+		}
+		if ( !file.flush() )
+			throw std::runtime_error( "Cannot write " + temporary );
+	}
+	if ( std::rename( temporary.c_str(), path.c_str() ) ) {
+		std::remove( temporary.c_str() );
+		throw std::runtime_error( "Cannot replace " + path );
+	}
+}
+
+inline int testbench::compare_baseline( const std::string& path ) {
+	std::ifstream file( path.c_str() );
+	std::vector<benchmark> baseline;
+	std::size_t n;
+	while( file >> n && n ) {
+		// The count isn't trusted to allocate in advance. A corrupt file
+		// ends the baseline, once reading a sample fails.
+		std::vector<double> samples;
+		double x;
+		while( samples.size() < n && file >> x )
+			samples.push_back( x );
+		std::string name;
+		file.get();
+		std::getline( file, name );
+		if ( !file )
+			break;
+		baseline.push_back( benchmark( name, std::move(samples) ) );
+	}
+	std::vector<benchmark> current;
+	{
+		std::lock_guard<std::mutex> guard( m_benchmark_lock );
+		for( auto& b : m_benchmarks ) {
+			current.push_back( benchmark( b.name, 
+				std::vector<double>( b.samples ) ) );
+		}
+	}
+	int comparisons{0};
+	for( auto& b : current ) {
+		auto base = std::find_if( baseline.begin(), baseline.end(), 
+			[&b]( const benchmark& x ) { return x.name == b.name; } );
+		if ( base == baseline.end() )
+			continue;
+		comparisons++;
+		const double tolerance{ m_policy.regression_tolerance };
+		std::vector<double> scaled( base->samples );
+		for( auto& x : scaled ) 
+			x *= 1.0 + tolerance;
+		const double p{ intern::mann_whitney( b.samples, scaled ) };
+		auto t = create( "Baseline: " + b.name );
+		if ( p < m_policy.significance )
+			t.m_log.add( true, intern::concatenate(
+				"Median of ", b.median, 
+				" ns/op is slower than baseline median of ", base->median,
+				" ns/op by more than ", tolerance * 100, 
+				"% (p=", p, ")." ) );
+		else
+			t.m_log.pass();
+	}
+	return comparisons;
+}
+
+inline void testbench::define( 
+	const std::string& name, 
+	std::function<void(testcase&)> body ) 
+{
+	m_jobs.push_back( job( name, std::move(body) ) );
+}
+
+template <class Setup>
+void testbench::fixture( const std::string& name, Setup setup ) {
+	typedef typename std::decay<decltype( setup() )>::type T;
+	std::unique_ptr<fixture_state> s( new fixture_state( 
+		name, 
+		typeid(T), 
+		[setup]() mutable -> std::shared_ptr<void> {
+			return std::make_shared<T>( setup() );
+		} ) );
+	std::lock_guard<std::mutex> guard( m_fixture_lock );
+	if ( !m_fixtures.emplace( name, std::move(s) ).second )
+		throw std::logic_error( 
+			"Fixture [" + name + "] is already declared." );
+}
+
+inline std::size_t testbench::define_registered() {
+	std::size_t n{0};
+	for( auto r = registration::first(); r; r = r->next(), n++ ) 
+		define( r->name(), r->body() );
+	return n;
+}
+
+inline void testbench::run( unsigned threads ) {
+	std::vector<job> jobs;
+	jobs.swap( m_jobs );
+	schedule( jobs );
+	if ( !threads ) 
+		threads = std::max( 1u, std::thread::hardware_concurrency() );
+	if ( threads > jobs.size() )
+		threads = std::max<std::size_t>( 1, jobs.size() );
+	
+	// Finished testcases write into their slot. The longest sequence of
+	// finished testcases from the front is then added to the testbench, 
+	// which keeps the order deterministic.
+	std::vector<log> slots;
+	slots.reserve( jobs.size() );
+	for( std::size_t i{0}; i < jobs.size(); i++ ) 
+		slots.push_back( log( jobs[i].name ) );
+	std::vector<bool> done( jobs.size(), false );
+	std::size_t next{0};
+	std::mutex merge;
+
+	{
+		std::lock_guard<std::mutex> guard( m_pending_lock );
+		m_pending = [&]() {
+			std::lock_guard<std::mutex> guard( merge );
+			for( std::size_t i{next}; i < slots.size(); i++ ) 
+				if ( done[i] )
+					add( std::move(slots[i]) );
+		};
+	}
+	scheduler sched( threads, jobs.size() );
+	auto work = [&]( std::size_t worker ) {
+		std::size_t i;
+		while( sched.pop( worker, i ) ) {
+			execute( jobs[i], slots[i] );
+			std::lock_guard<std::mutex> guard( merge );
+			done[i] = true;
+			for( ; next < slots.size() && done[next]; next++ ) 
+				add( std::move(slots[next]) );
+		}
+	};
+	std::vector<std::thread> workers;
+	for( unsigned w{1}; w < threads; w++ ) 
+		workers.push_back( std::thread( work, w ) );
+	work( 0 );
+	for( auto& w : workers ) 
+		w.join();
+	std::lock_guard<std::mutex> guard( m_pending_lock );
+	m_pending = nullptr;
+}
+
+inline void testbench::load_history( const std::string& path ) {
+	auto loaded = intern::load_history( path );
+	drain();
+	std::lock_guard<std::mutex> guard( m_drain );
+	for( auto& h : loaded )
+		m_history[h.first] = h.second;
+	m_recording = true;
+	m_scheduling = true;
+}
+
+inline void testbench::record_history() {
+	drain();
+	std::lock_guard<std::mutex> guard( m_drain );
+	m_recording = true;
+}
+
+inline void testbench::save_history( const std::string& path ) const {
+	drain();
+	std::lock_guard<std::mutex> guard( m_drain );
+	intern::save_history( path, m_history );
+}
+
+inline std::vector<double> testbench::expected_durations( 
+	const std::vector<job>& jobs ) const 
+{
+	drain();
+	std::lock_guard<std::mutex> guard( m_drain );
+	std::vector<double> durations;
+	double sum{0};
+	std::size_t count{0};
+	for( auto& j : jobs ) {
+		auto h = m_history.find( j.name );
+		durations.push_back( h != m_history.end() 
+			? double( h->second.duration ) 
+			: -1.0 );
+		if ( h != m_history.end() ) {
+			sum += h->second.duration;
+			count++;
+		}
+	}
+	for( auto& d : durations ) {
+		if ( d < 0 )
+			d = count ? sum / count : 1.0;
+	}
+	return durations;
+}
+
+inline void testbench::schedule( std::vector<job>& jobs ) const {
+	if ( !m_scheduling )
+		return;
+	const auto durations = expected_durations( jobs );
+	std::vector<bool> failed;
+	{
+		std::lock_guard<std::mutex> guard( m_drain );
+		for( auto& j : jobs ) {
+			auto h = m_history.find( j.name );
+			failed.push_back( h != m_history.end() && h->second.failed );
+		}
+	}
+	std::vector<std::size_t> order( jobs.size() );
+	for( std::size_t i{0}; i < order.size(); i++ )
+		order[i] = i;
+	std::stable_sort( order.begin(), order.end(), 
+		[&]( std::size_t a, std::size_t b ) {
+			if ( failed[a] != failed[b] )
+				return bool( failed[a] );
+			return durations[a] > durations[b];
+		} );
+	std::vector<job> sorted;
+	sorted.reserve( jobs.size() );
+	for( auto i : order )
+		sorted.push_back( std::move( jobs[i] ) );
+	jobs.swap( sorted );
+}
+
+inline void testbench::expire( 
+	const std::vector<std::pair<std::string,std::string>>& failures ) 
+{
+	{
+		std::lock_guard<std::mutex> guard( m_pending_lock );
+		if ( m_pending )
+			m_pending();
+	}
+	for( auto& f : failures ) {
+		log l( f.first );
+		prepare( l );
+		l.aborted = false;
+		l.add( true, f.second );
+		add( std::move(l) );
+	}
+	finish();
+	*m_output << *this << '\n';
+	m_output->flush();
+	std::fflush( nullptr );
+	std::_Exit( 1 );
+}
+
+inline void testbench::execute( job& j, log& slot ) {
+	testcase t( j.name, this, &slot );
+	if ( t.aborted() ) 
+		return;
+	try {
+		j.body( t );
+	}
+	catch( std::exception& e ) {
+		t.m_log.add( true, intern::concatenate(
+			"Unhandled std::exception: [",
+			e.what(),
+			"]") );
+	}
+	catch( ... ) {
+		t.m_log.add( true, std::string(
+			"Unhandled exception (unknown type).") );
+	}
+}
+
+inline void testbench::prepare( log& l ) {
+	if ( m_policy.retain_logs ) 
+		l.pool = m_arena.get();
+	else {
+		// The messages are discarded together with the log.
+		l.own_pool.reset( new arena );
+		l.own_pool->limit( 
+			m_policy.max_message_bytes, 
+			m_policy.drop_oldest_messages );
+		l.pool = l.own_pool.get();
+	}
+	l.max_failed_checks = m_policy.max_failed_checks;
+	l.max_entries = m_policy.max_entries;
+	l.aborted = aborted();
+}
+
+inline void testbench::run_isolated( unsigned workers ) {
+#ifndef ELRAT_TESTBENCH_FORK
+	run( workers );
+#else
+	typedef std::chrono::steady_clock clock;
+	std::vector<job> jobs;
+	jobs.swap( m_jobs );
+	schedule( jobs );
+	if ( !workers ) 
+		workers = std::max( 1u, std::thread::hardware_concurrency() );
+	if ( workers > jobs.size() )
+		workers = std::max<std::size_t>( 1, jobs.size() );
+
+	// Same as with 'run', the results are added in order of definition.
+	std::vector<log> slots;
+	slots.reserve( jobs.size() );
+	for( std::size_t i{0}; i < jobs.size(); i++ ) 
+		slots.push_back( log( jobs[i].name ) );
+	std::vector<bool> done( jobs.size(), false );
+	std::size_t next{0};
+	std::size_t next_job{0};
+	auto finish = [&]( std::size_t i ) {
+		done[i] = true;
+		for( ; next < slots.size() && done[next]; next++ ) 
+			add( std::move(slots[next]) );
+	};
+	auto fail = [&]( 
+		std::size_t i, 
+		const std::string& msg, 
+		clock::time_point start ) 
+	{
+		log l( jobs[i].name );
+		prepare( l );
+		l.aborted = false;
+		l.add( true, msg );
+		l.used.wall_time = std::chrono::duration_cast<
+			std::chrono::nanoseconds>( clock::now() - start );
+		slots[i] = std::move(l);
+		finish( i );
+	};
+
+	struct worker {
+		pid_t pid;
+		int commands; // job indices to the worker
+		int results;  // serialized logs from the worker
+		bool busy;
+		std::size_t job;
+		clock::time_point start;
+		std::string buffer;
+	};
+	std::vector<worker> pool;
+	auto spawn = [&]( worker& w ) {
+		int commands[2];
+		int results[2];
+		if ( ::pipe( commands ) ) 
+			throw std::runtime_error( "Cannot create pipe." );
+		if ( ::pipe( results ) ) {
+			::close( commands[0] );
+			::close( commands[1] );
+			throw std::runtime_error( "Cannot create pipe." );
+		}
+		std::cout.flush();
+		std::cerr.flush();
+		std::fflush( nullptr );
+		const pid_t pid = ::fork();
+		if ( pid < 0 ) 
+			throw std::runtime_error( "Cannot fork worker process." );
+		if ( !pid ) {
+			::close( commands[1] );
+			::close( results[0] );
+			for( auto& other : pool ) {
+				if ( other.pid > 0 && &other != &w ) {
+					::close( other.commands );
+					::close( other.results );
+				}
+			}
+
+			// The thread of the watchdog doesn't exist in this process,
+			// and its lock may be held. The parent enforces the timeouts.
+			m_watchdog.release();
+			std::uint64_t i;
+			std::string message;
+			while( intern::read_all( commands[0], &i, sizeof(i) ) ) {
+				log slot( jobs[i].name );
+				execute( jobs[i], slot );
+				message.clear();
+				intern::serialize( slot, message );
+				if ( !intern::write_all( results[1], 
+					message.data(), 
+					message.size() ) )
+					break;
+			}
+			std::cout.flush();
+			std::_Exit( 0 );
+		}
+		::close( commands[0] );
+		::close( results[1] );
+		w.pid = pid;
+		w.commands = commands[1];
+		w.results = results[0];
+		w.busy = false;
+		w.buffer.clear();
+	};
+	auto retire = [&]( worker& w, bool kill ) {
+		if ( kill )
+			::kill( w.pid, SIGKILL );
+		::close( w.commands );
+		::close( w.results );
+		int status{0};
+		::waitpid( w.pid, &status, 0 );
+		w.pid = -1;
+		w.busy = false;
+		return status;
+	};
+	auto dispatch = [&]( worker& w ) {
+		for( ; next_job < jobs.size() && aborted(); next_job++ ) {
+			execute( jobs[next_job], slots[next_job] );
+			finish( next_job );
+		}
+		if ( next_job == jobs.size() ) 
+			return;
+		if ( w.pid < 0 )
+			spawn( w );
+		const std::uint64_t i{ next_job++ };
+		w.busy = true;
+		w.job = i;
+		w.start = clock::now();
+		
+		// If the worker is gone, that's noticed by reading its results.
+		intern::write_all( w.commands, &i, sizeof(i) );
+	};
+
+	// A worker, that crashed, closes the pipes. Writing to them must not
+	// terminate this process.
+	auto sigpipe = ::signal( SIGPIPE, SIG_IGN );
+	const auto timeout = m_policy.testcase_timeout;
+	const auto global = m_policy.global_timeout;
+	m_isolating = true;
+	pool.resize( workers );
+	for( auto& w : pool ) 
+		w.pid = -1;
+	for( auto& w : pool )
+		dispatch( w );
+	for( ;; ) {
+		std::vector<pollfd> fds;
+		std::vector<worker*> owners;
+		int wait{-1};
+		for( auto& w : pool ) {
+			if ( !w.busy ) 
+				continue;
+			pollfd fd;
+			fd.fd = w.results;
+			fd.events = POLLIN;
+			fd.revents = 0;
+			fds.push_back( fd );
+			owners.push_back( &w );
+			if ( timeout.count() ) {
+				auto left = std::chrono::duration_cast<
+					std::chrono::milliseconds>( 
+					w.start + timeout - clock::now() ).count() + 1;
+				left = std::max<decltype(left)>( 0, left );
+				if ( wait < 0 || left < wait ) 
+					wait = static_cast<int>( left );
+			}
+			if ( global.count() ) {
+				auto left = std::chrono::duration_cast<
+					std::chrono::milliseconds>( 
+					m_started + global - clock::now() ).count() + 1;
+				left = std::max<decltype(left)>( 0, left );
+				if ( wait < 0 || left < wait ) 
+					wait = static_cast<int>( left );
+			}
+		}
+		if ( fds.empty() ) 
+			break;
+		if ( ::poll( fds.data(), fds.size(), wait ) < 0 && errno != EINTR ) 
+			break;
+		for( std::size_t k{0}; k < fds.size(); k++ ) {
+			worker& w = *owners[k];
+			if ( !fds[k].revents ) 
+				continue;
+			char buffer[4096];
+			const ssize_t n = ::read( w.results, buffer, sizeof(buffer) );
+			if ( n > 0 ) {
+				w.buffer.append( buffer, n );
+				std::uint32_t size;
+				if ( w.buffer.size() < sizeof(size) ) 
+					continue;
+				std::memcpy( &size, w.buffer.data(), sizeof(size) );
+				if ( w.buffer.size() < sizeof(size) + size ) 
+					continue;
+				log l( jobs[w.job].name );
+				prepare( l );
+				if ( intern::deserialize( w.buffer, l ) ) {
+					slots[w.job] = std::move(l);
+					finish( w.job );
+				}
+				else
+					fail( w.job, "Invalid result of worker process.", 
+						w.start );
+				w.buffer.clear();
+				w.busy = false;
+				dispatch( w );
+			}
+			else if ( n == 0 || errno != EINTR ) {
+				const std::size_t i{ w.job };
+				const clock::time_point start{ w.start };
+				const int status{ retire( w, false ) };
+				if ( WIFSIGNALED(status) ) 
+					fail( i, intern::concatenate( 
+						"Worker process terminated by signal ", 
+						WTERMSIG(status), 
+						" (", ::strsignal( WTERMSIG(status) ), ")." ),
+						start );
+				else
+					fail( i, intern::concatenate( 
+						"Worker process exited with status ", 
+						WEXITSTATUS(status), "." ), 
+						start );
+				dispatch( w );
+			}
+		}
+		for( auto& w : pool ) {
+			if ( !w.busy || !timeout.count() 
+				|| clock::now() - w.start < timeout ) 
+				continue;
+			const std::size_t i{ w.job };
+			const clock::time_point start{ w.start };
+			retire( w, true );
+			fail( i, intern::concatenate( 
+				"Timed out after ", 
+				intern::duration( timeout ), "." ), 
+				start );
+			dispatch( w );
+		}
+
+		// The remaining testcases fail without being executed.
+		if ( global.count() && clock::now() - m_started >= global ) {
+			const std::string msg( intern::concatenate( 
+				"Global timeout of ", intern::duration( global ), 
+				" exceeded." ) );
+			for( auto& w : pool ) {
+				if ( !w.busy ) 
+					continue;
+				const std::size_t i{ w.job };
+				const clock::time_point start{ w.start };
+				retire( w, true );
+				fail( i, msg, start );
+			}
+			for( ; next_job < jobs.size(); next_job++ )
+				fail( next_job, msg, clock::now() );
+		}
+	}
+	m_isolating = false;
+	for( auto& w : pool ) 
+		if ( w.pid > 0 ) 
+			retire( w, false );
+	::signal( SIGPIPE, sigpipe );
+#endif
+}
+
+inline int testbench::main( int argc, char* argv[], std::ostream& os ) {
+	std::string filter;
+	std::string regex;
+	std::string history;
+	std::string save_history_to;
+	bool list{false};
+	bool isolate{false};
+	bool update_goldens{false};
+	unsigned long threads{1};
+	unsigned long shard_index{0};
+	unsigned long shard_count{1};
+	std::regex re;
+	try {
+		for( int i{1}; i < argc; i++ ) {
+			const std::string arg( argv[i] );
+			std::string v;
+			auto option = [&]( const char* name, std::string& value ) {
+				const std::string prefix( std::string( name ) + "=" );
+				if ( arg.compare( 0, prefix.size(), prefix ) )
+					return false;
+				value = arg.substr( prefix.size() );
+				return true;
+			};
+			if ( arg == "--list" )
+				list = true;
+			else if ( arg == "--isolate" )
+				isolate = true;
+			else if ( arg == "--update-goldens" )
+				update_goldens = true;
+			else if ( option( "--filter", filter ) 
+				|| option( "--regex", regex ) 
+				|| option( "--history", history ) 
+				|| option( "--save-history", save_history_to ) )
+				continue;
+			else if ( option( "--threads", v ) )
+				threads = std::stoul( v );
+			else if ( option( "--shard-index", v ) )
+				shard_index = std::stoul( v );
+			else if ( option( "--shard-count", v ) )
+				shard_count = std::stoul( v );
+			else 
+				throw std::invalid_argument( "Unknown option " + arg );
+		}
+		if ( !shard_count || shard_index >= shard_count )
+			throw std::invalid_argument( "Invalid shard index or count." );
+		re = std::regex( regex );
+	}
+	catch( std::exception& e ) {
+		os << "Invalid arguments: " << e.what() << '\n';
+		return 2;
+	}
+
+	std::vector<job> jobs;
+	for( auto& j : m_jobs ) {
+		if ( ( filter.empty() || intern::glob( filter, j.name ) )
+			&& ( regex.empty() || std::regex_search( j.name, re ) ) )
+			jobs.push_back( std::move(j) );
+	}
+	m_jobs.clear();
+
+	if ( !history.empty() )
+		load_history( history );
+	if ( !save_history_to.empty() )
+		record_history();
+	const auto weights = expected_durations( jobs );
+	for( auto i : intern::shard( weights, shard_count, shard_index ) )
+		m_jobs.push_back( std::move( jobs[i] ) );
+
+	if ( list ) {
+		for( auto& j : m_jobs )
+			os << j.name << '\n';
+		m_jobs.clear();
+		return 0;
+	}
+
+	if ( update_goldens )
+		m_policy.update_goldens = true;
+	m_output = &os;
+	if ( isolate )
+		run_isolated( threads );
+	else
+		run( threads );
+	finish();
+	os << *this << '\n';
+	if ( !save_history_to.empty() )
+		save_history( save_history_to );
+	m_output = &std::cout;
+	return failed_testcases() ? 1 : 0;
+}
+
+//
+// testbench::policy
+//
+inline testbench::policy::policy()
+: max_failed_checks{0}
+, max_failed_testcases{0}
+, max_entries{0}
+, max_message_bytes{0}
+, drop_oldest_messages{false}
+, samples{10}
+, sample_time{ std::chrono::milliseconds(10) }
+, regression_tolerance{0.05}
+, significance{0.01}
+, retain_logs{true}
+, testcase_timeout{0}
+, global_timeout{0}
+, slowest_testcases{5}
+, max_mismatches{8}
+, property_cases{100}
+, property_budget{0}
+, property_shrinks{1000}
+, property_seed{0}
+, property_shards{1}
+, update_goldens{ intern::enabled( "ELRAT_TESTBENCH_UPDATE_GOLDENS" ) } {
+
+}
+
+//
+// testbench::reporter
+// testbench::json_lines_reporter
+// testbench::junit_reporter
+//
+inline testbench::reporter::~reporter() {
+
+}
+
+inline void testbench::reporter::begin( const testbench& ) {
+
+}
+
+inline void testbench::reporter::end( const testbench& ) {
+
+}
+
+inline testbench::json_lines_reporter::json_lines_reporter( std::ostream& os ) 
+: m_os(os) {
+
+}
+
+inline void testbench::json_lines_reporter::report( 
+	const testbench& tb, 
+	const log& l ) 
+{
+	m_os << "{\"testbench\":\"" << intern::json_escape( tb.name() )
+		<< "\",\"testcase\":\"" << intern::json_escape( l.name )
+		<< "\",\"checks\":" << l.check_count
+		<< ",\"failed_checks\":" << l.failed_count
+		<< ",\"aborted\":" << ( l.aborted ? "true" : "false" )
+		<< ",\"failures\":[";
+	for( std::size_t i{0}; i < l.entries.size(); i++ ) {
+		m_os << ( i ? "," : "" )
+			<< "{\"check\":" << l.entries[i].position
+			<< ",\"message\":\"" 
+			<< intern::json_escape( l.entries[i].message() ) 
+			<< "\"}";
+	}
+	m_os << "]}\n" << std::flush;
+}
+
+inline void testbench::json_lines_reporter::end( const testbench& tb ) {
+	auto totals = tb.totals();
+	m_os << "{\"testbench\":\"" << intern::json_escape( tb.name() )
+		<< "\",\"testcases\":" << totals.testcases
+		<< ",\"checks\":" << totals.checks
+		<< ",\"failed_testcases\":" << totals.failed_testcases
+		<< ",\"failed_checks\":" << totals.failed_checks
+		<< "}\n" << std::flush;
+}
+
+inline testbench::junit_reporter::junit_reporter( std::ostream& os ) 
+: m_os(os) {
+
+}
+
+inline void testbench::junit_reporter::begin( const testbench& tb ) {
+	m_os << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+		<< "<testsuite name=\"" << intern::xml_escape( tb.name() ) 
+		<< "\">\n" << std::flush;
+}
+
+inline void testbench::junit_reporter::report( 
+	const testbench& tb, 
+	const log& l ) 
+{
+	m_os << "  <testcase classname=\"" << intern::xml_escape( tb.name() )
+		<< "\" name=\"" << intern::xml_escape( l.name ) << '\"';
+	if ( l.failed_count ) {
+		m_os << ">\n    <failure message=\"" 
+			<< l.failed_count << " of " << l.check_count 
+			<< " checks failed\">";
+		for( auto& e : l.entries ) 
+			m_os << '#' << e.position << ": " 
+				<< intern::xml_escape( e.message() ) << '\n';
+		m_os << "</failure>\n  </testcase>\n";
+	}
+	else if ( l.aborted ) 
+		m_os << ">\n    <skipped/>\n  </testcase>\n";
+	else
+		m_os << "/>\n";
+	m_os << std::flush;
+}
+
+inline void testbench::junit_reporter::end( const testbench& ) {
+	m_os << "</testsuite>\n" << std::flush;
+}
+
+//
+// testbench::benchmark
+//
+inline testbench::benchmark::benchmark( 
+	const std::string& s, 
+	std::vector<double>&& v )
+: name{s}
+, iterations{0}
+, samples{std::move(v)}
+, mean{0}
+, median{0}
+, stddev{0}
+, min{0}
+, max{0} {
+	if ( !samples.size() )
+		return;
+	std::vector<double> sorted( samples );
+	std::sort( sorted.begin(), sorted.end() );
+	const std::size_t n{ sorted.size() };
+	min = sorted.front();
+	max = sorted.back();
+	median = n % 2 
+		? sorted[n/2] 
+		: ( sorted[n/2-1] + sorted[n/2] ) / 2;
+	for( auto x : sorted )
+		mean += x;
+	mean /= n;
+	for( auto x : sorted )
+		stddev += (x-mean) * (x-mean);
+	stddev = n > 1 ? std::sqrt( stddev / (n-1) ) : 0;
+}
+
+//
+// testbench::resources
+//
+inline testbench::resources::resources()
+: wall_time{0}, cpu_time{0}, allocations{0}, allocated_bytes{0} {
+
+}
+
+//
+// testbench::counts
+//
+inline testbench::counts::counts()
+: testcases{0}, checks{0}, failed_testcases{0}, failed_checks{0} {
+
+}
+
+//
+// testbench::submission
+//
+inline testbench::submission::submission( log&& l ) 
+: result{std::move(l)}, next{nullptr} {
+
+}
+
+//
+// testbench::job
+//
+inline testbench::job::job( 
+	const std::string& n, 
+	std::function<void(testcase&)>&& b ) 
+: name{n}, body{std::move(b)} {
+
+}
+
+//
+// testbench::fixture_state
+//
+inline testbench::fixture_state::fixture_state( 
+	const std::string& n, 
+	const std::type_info& t,
+	std::function<std::shared_ptr<void>()>&& s )
+: name{n}, type(t), setup{std::move(s)}, setup_time{0} {
+
+}
+
+//
+// testbench::registration
+//
+inline testbench::registration::registration( 
+	const char* name, 
+	function body )
+: m_name{name}, m_body{body}, m_next{nullptr} {
+	list& l = registry();
+	if ( l.last ) 
+		l.last->m_next = this;
+	else
+		l.first = this;
+	l.last = this;
+}
+
+inline const char* testbench::registration::name() const {
+	return m_name;
+}
+
+inline testbench::registration::function 
+testbench::registration::body() const {
+	return m_body;
+}
+
+inline const testbench::registration* testbench::registration::next() const {
+	return m_next;
+}
+
+inline const testbench::registration* testbench::registration::first() {
+	return registry().first;
+}
+
+inline testbench::registration::list& testbench::registration::registry() {
+	// constant-initialized, so it's valid before any registration
+	static list l{ nullptr, nullptr };
+	return l;
+}
+
+//
+// testbench::watchdog
+//
+inline testbench::watchdog::watchdog( testbench& tb, const policy& p )
+: m_tb(tb)
+, m_testcase_timeout{ p.testcase_timeout }
+, m_global_timeout{ p.global_timeout }
+, m_stop{false}
+, m_next{1} {
+	m_thread = std::thread( &watchdog::loop, this );
+}
+
+inline testbench::watchdog::~watchdog() {
+	{
+		std::lock_guard<std::mutex> guard( m_lock );
+		m_stop = true;
+	}
+	m_wake.notify_one();
+	m_thread.join();
+}
+
+inline std::uint64_t testbench::watchdog::watch( const std::string& name ) {
+	std::lock_guard<std::mutex> guard( m_lock );
+	m_watched.push_back( watched{ m_next, name, clock::now() } );
+	return m_next++;
+}
+
+inline void testbench::watchdog::unwatch( std::uint64_t id ) {
+	std::lock_guard<std::mutex> guard( m_lock );
+	auto w = std::find_if( m_watched.begin(), m_watched.end(), 
+		[id]( const watched& x ) { return x.id == id; } );
+	if ( w != m_watched.end() )
+		m_watched.erase( w );
+}
+
+inline void testbench::watchdog::loop() {
+	std::vector<std::pair<std::string,std::string>> expired;
+	std::unique_lock<std::mutex> lock( m_lock );
+	while ( !m_stop ) {
+		m_wake.wait_for( lock, std::chrono::milliseconds(10) );
+		const auto now = clock::now();
+		const bool global{ m_global_timeout.count() && !m_tb.m_isolating 
+			&& now - m_tb.m_started > m_global_timeout };
+		for( auto& w : m_watched ) {
+			if ( global ) 
+				expired.push_back( std::make_pair( w.name, 
+					intern::concatenate( "Global timeout of ", 
+						intern::duration( m_global_timeout ), 
+						" exceeded after ",
+						intern::duration( std::chrono::duration_cast<
+						std::chrono::nanoseconds>( now - w.start ) ), "." ) ) );
+			else if ( m_testcase_timeout.count() 
+				&& now - w.start > m_testcase_timeout )
+				expired.push_back( std::make_pair( w.name, 
+					intern::concatenate( "Timed out after ", 
+						intern::duration( std::chrono::duration_cast<
+						std::chrono::nanoseconds>( now - w.start ) ), 
+						" (timeout: ", 
+						intern::duration( m_testcase_timeout ), ")." ) ) );
+		}
+		if ( !expired.empty() ) {
+			lock.unlock();
+			m_tb.expire( expired );
+		}
+	}
+}
+
+//
+// testbench::mapping
+//
+inline testbench::mapping::mapping( const std::string& path )
+: m_open{false}, m_size{0}, m_data{nullptr} {
+#ifdef ELRAT_TESTBENCH_MMAP
+	const int fd = ::open( path.c_str(), O_RDONLY );
+	if ( fd >= 0 ) {
+		struct stat st;
+		if ( !::fstat( fd, &st ) && S_ISREG( st.st_mode ) ) {
+			m_open = true;
+			m_size = static_cast<std::size_t>( st.st_size );
+			void* p = m_size 
+				? ::mmap( nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0 )
+				: MAP_FAILED;
+			if ( p != MAP_FAILED ) {
+				::madvise( p, m_size, MADV_SEQUENTIAL );
+				m_data = static_cast<const char*>( p );
+			}
+		}
+		::close( fd );
+		if ( !m_open || m_data || !m_size )
+			return;
+	}
+#endif
+	m_file.open( path.c_str(), std::ios::binary );
+	if ( !m_file )
+		return;
+	m_file.seekg( 0, std::ios::end );
+	const std::streamoff size = m_file.tellg();
+	if ( size < 0 ) 
+		return;
+	m_open = true;
+	m_size = static_cast<std::size_t>( size );
+}
+
+inline testbench::mapping::~mapping() {
+#ifdef ELRAT_TESTBENCH_MMAP
+	if ( m_data )
+		::munmap( const_cast<char*>( m_data ), m_size );
+#endif
+}
+
+inline bool testbench::mapping::is_open() const {
+	return m_open;
+}
+
+inline std::size_t testbench::mapping::size() const {
+	return m_size;
+}
+
+inline const char* testbench::mapping::view( 
+	std::size_t offset, 
+	std::size_t n ) 
+{
+	if ( m_data )
+		return m_data + offset;
+	m_buffer.resize( std::max<std::size_t>( n, 1 ) );
+	m_file.clear();
+	m_file.seekg( static_cast<std::streamoff>( offset ) );
+	m_file.read( &m_buffer[0], static_cast<std::streamsize>( n ) );
+	if ( m_file.gcount() != static_cast<std::streamsize>( n ) )
+		throw std::runtime_error( "Cannot read the file." );
+	return &m_buffer[0];
+}
+
+//
+// testbench::scheduler
+//
+inline testbench::scheduler::scheduler( 
+	std::size_t workers, 
+	std::size_t jobs ) 
+{
+	for( std::size_t w{0}; w < workers; w++ ) 
+		m_queues.push_back( std::unique_ptr<queue>( new queue ) );
+	for( std::size_t i{0}; i < jobs; i++ ) 
+		m_queues[ i % workers ]->jobs.push_back( i );
+}
+
+inline bool testbench::scheduler::pop( std::size_t worker, std::size_t& job ) {
+	{
+		queue& own = *m_queues[worker];
+		std::lock_guard<std::mutex> guard( own.lock );
+		if ( own.jobs.size() ) {
+			job = own.jobs.front();
+			own.jobs.pop_front();
+			return true;
+		}
+	}
+	for( std::size_t k{1}; k < m_queues.size(); k++ ) {
+		queue& other = *m_queues[ (worker + k) % m_queues.size() ];
+		std::lock_guard<std::mutex> guard( other.lock );
+		if ( other.jobs.size() ) {
+			job = other.jobs.back();
+			other.jobs.pop_back();
+			return true;
+		}
+	}
+	return false;
+}
+
+//
+// testbench::testcase
+//
+
+// c - The callable, that's performing the comparison and returns a bool.
+// m - The callable, that's creating the feedback message. It is invoked only
+//     if the comparison returned 'false', so passing checks don't pay for 
+//     the formatting.
+template <class Compare, class Message>
+void testbench::testcase::nothrow_cmp( Compare&& c, Message&& m ) {
+#if ELRAT_TESTBENCH_CHECKS != ELRAT_TESTBENCH_CHECKS_FULL
+#if ELRAT_TESTBENCH_CHECKS == ELRAT_TESTBENCH_CHECKS_COUNT
+	if ( m_log.aborted )
+		return;
+#endif
+	if ( c() )
+		m_log.pass();
+	else if ( m_log.recording() )
+		m_log.add( true, m() );
+	else
+		m_log.add( true, "", 0 );
+#else
+	if ( m_log.aborted )
+		return;
+	bool op_result;
+	try {
+		op_result = c();
+	} 
+	catch( std::exception& e ) {
+		m_log.add( true, intern::concatenate(
+			"std::exception: [",
+			e.what(),
+			"]") );
+		return;
+	}
+	catch( ... ) {
+		m_log.add( true, "exception (unknown type)." );
+		return;
+	}	
+	if ( op_result )
+		m_log.pass();
+	else if ( m_log.recording() )
+		m_log.add( true, m() );
+	else
+		m_log.add( true, "", 0 );
+#endif
+}
+
+inline testbench::testcase::testcase( 
+	const std::string& name, 
+	testbench* parent, 
+	log* slot ) 
+: m_log(name), m_parent{parent}, m_slot{slot}, m_watch{0}
+, m_start{ std::chrono::steady_clock::now() }
+, m_cpu_start{ intern::thread_cpu_time() }
+, m_allocations_start( allocations::current() ) {
+	if ( parent )
+		parent->prepare( m_log );
+	if ( parent && parent->m_watchdog )
+		m_watch = parent->m_watchdog->watch( name );
+}
+
+inline testbench::testcase::testcase( testcase&& other )
+: m_log( std::move(other.m_log) )
+, m_parent{other.m_parent}
+, m_slot{other.m_slot}
+, m_watch{other.m_watch}
+, m_start{other.m_start}
+, m_cpu_start{other.m_cpu_start}
+, m_allocations_start( other.m_allocations_start ) {
+	other.m_parent = nullptr;
+	other.m_slot = nullptr;
+	other.m_watch = 0;
+}
+
+inline testbench::testcase::~testcase() {
+	if ( m_watch && m_parent && m_parent->m_watchdog )
+		m_parent->m_watchdog->unwatch( m_watch );
+	resources& used = m_log.used;
+	used.wall_time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - m_start );
+	used.cpu_time = intern::thread_cpu_time() - m_cpu_start;
+	const allocations& current = allocations::current();
+	used.allocations = current.count - m_allocations_start.count;
+	used.allocated_bytes = current.bytes - m_allocations_start.bytes;
+	if ( m_slot )
+		*m_slot = std::move(m_log);
+	else if ( m_parent )
+		m_parent->add( std::move(m_log) );
+}
+
+inline bool testbench::testcase::aborted() const {
+	return m_log.aborted;
+}
+
+template <class T>
+void testbench::testcase::check( const T& t ) {
+	if ( static_cast<bool>(t) )
+		m_log.pass();
+	else
+		m_log.add( true, "Expression evaluated to 'false'." );
+}
+
+template <class T>
+void testbench::testcase::equal( const T& a, const T& b ) {
+	nothrow_cmp( 
+		[&](){
+			return (a==b);
+		},
+		[&](){
+			return ELRAT_TESTBENCH_FORMAT(
+				"Expected [{}], but found [{}].", b, a );
+		}
+	);
+}
+
+template <class T>
+void testbench::testcase::equal( const T& a, const T& b, const T& th ) {
+	nothrow_cmp(
+		[&](){
+			return !intern::is_nan(a) && !intern::is_nan(b) 
+				&& !(std::abs(a-b) > th);
+		},
+		[&](){
+			return ELRAT_TESTBENCH_FORMAT(
+				"Expected [{}], but found [{}]. Absolute deviation={}"
+				" exceeds threshold={}", b, a, std::abs(a-b), th );
+		}
+	);
+}
+
+template <class T>
+void testbench::testcase::near_ulps( T a, T b, std::uint64_t ulps ) {
+	nothrow_cmp(
+		[&](){
+			return !intern::is_nan(a) && !intern::is_nan(b) 
+				&& intern::ulps( a, b ) <= ulps;
+		},
+		[&](){
+			if ( intern::is_nan(a) || intern::is_nan(b) )
+				return ELRAT_TESTBENCH_FORMAT(
+					"Expected [{}], but found [{}].", b, a );
+			return ELRAT_TESTBENCH_FORMAT(
+				"Expected [{}], but found [{}]. Distance of {} ulps "
+				"exceeds threshold={}", b, a, intern::ulps( a, b ), ulps );
+		}
+	);
+}
+
+template <class T>
+void testbench::testcase::near_relative( T a, T b, T rel ) {
+	nothrow_cmp(
+		[&](){
+			return intern::near_relative( a, b, rel );
+		},
+		[&](){
+			return ELRAT_TESTBENCH_FORMAT(
+				"Expected [{}], but found [{}]. Relative deviation "
+				"exceeds threshold={}", b, a, rel );
+		}
+	);
+}
+
+template <class T>
+void testbench::testcase::near( T a, T b, T abs, T rel ) {
+	nothrow_cmp(
+		[&](){
+			return intern::near( a, b, abs, rel );
+		},
+		[&](){
+			return ELRAT_TESTBENCH_FORMAT(
+				"Expected [{}], but found [{}]. Deviation exceeds "
+				"threshold abs={}, rel={}", b, a, abs, rel );
+		}
+	);
+}
+
+template <class T>
+void testbench::testcase::less_than( const T& a, const T& b ) {
+	nothrow_cmp(
+		[&](){
+			return a < b;
+		},
+		[&](){
+			return ELRAT_TESTBENCH_FORMAT(
+				"Expected value to be less than [{}], but found [{}].", 
+				b, a );
+		}
+	);
+}
+
+template <class T>
+void testbench::testcase::less_than_or_equal( const T& a, const T& b ) {
+	nothrow_cmp(
+		[&](){
+			return a <= b;
+		},
+		[&](){
+			return ELRAT_TESTBENCH_FORMAT(
+				"Expected value to be less than or equal to [{}], "
+				"but found [{}].", b, a );
+		}
+	);
+}
+
+template <class T>
+void testbench::testcase::greater_than( const T& a, const T& b ) {
+	nothrow_cmp(
+		[&](){
+			return a > b;
+		},
+		[&](){
+			return ELRAT_TESTBENCH_FORMAT( 
+				"Expected value to be greater than [{}], but found [{}].",
+				b, a );
+		}
+	);
+}
+
+template <class T>
+void testbench::testcase::greater_than_or_equal( const T& a, const T& b ) {
+	nothrow_cmp( 
+		[&](){
+			return a >= b;
+		},
+		[&](){
+			return ELRAT_TESTBENCH_FORMAT( 
+				"Expected value to be greater than or equal to [{}], "
+				"but found [{}].", b, a );
+		}
+	);
+}
+
+template <class T>
+void testbench::testcase::in_range( const T& a, const T& lo, const T& hi ) {
+	nothrow_cmp(
+		[&](){
+			return ( a >= lo && a <= hi );
+		},
+		[&](){
+			return ELRAT_TESTBENCH_FORMAT(
+				"Expected value in [{}, {}], but found [{}].", lo, hi, a );
+		}
+	);
+}
+
+template <class T>
+void testbench::testcase::not_in_range(const T& a, const T& lo, const T& hi) {
+	nothrow_cmp(
+		[&](){
+			return ( a < lo || a > hi );
+		},
+		[&](){
+			return ELRAT_TESTBENCH_FORMAT(
+				"Expected value to be less that [{}] or greater than [{}], "
+				"but found [{}].", lo, hi, a );
+		}
+	);
+}
+
+template <class Callable>
+void testbench::testcase::does_not_throw( Callable&& callable ) {
+	if ( m_log.aborted )
+		return;
+	try {
+		callable();
+		m_log.pass();
+	}
+	catch( std::exception& e ) {
+		m_log.add( true, intern::concatenate( 
+			"Exception should not be thrown, but caught ", e.what() ) );
+	}
+	catch( ... ) {
+		m_log.add( true, "Exception should not be thrown, but caught "
+			"exception of unknown type." );
+	}
+}
+
+// Problem: When template parameter Exception is of type std::exception, the 
+// 	compiler warns about the exception be caught earlier, in the 
+// 	catch-statement before. I don't want to turn warnings off. The library
+// 	should compile and work without any sharp edges to it.
+//
+// Solution attempts:
+// - Partial template specialization (Exception=std::std::exception), but it's
+// 	not allowed. A full template specialization seems not possible because
+// 	of the template parameter 'Callable'.
+// - Used the approach of 
+// 	[if constexpr std::is_same<Exception,std::exception>::value], 
+// 	but this requires C++17, which I don't want to enforce at the moment.
+//
+// Current solution:
+// - If it's irrelevant what type of exception is thrown, use 'throws_any'.
+// - If *any* std::exception is expected, use 'throws_stdexcept'
+// - If one specific exception type, which can also be a derivative of 
+// 	std::exception, is expected, then use 'throws', 
+// 	e.g. 'throws<std::range_error>'.
+template <class Exception, class Callable>
+void testbench::testcase::throws( Callable&& callable ) {
+	static_assert( !std::is_same<Exception,std::exception>::value, 
+		"Sorry for the inconvenience, but may I refer you"
+		"to 'throws_stdexcept()' instead!" );
+	if ( m_log.aborted )
+		return;
+	try {
+		callable();
+		m_log.add( true, "No exception has been raised." );
+	}
+	catch( Exception& e ) {
+		m_log.pass();
+	}
+	catch( std::exception& e ) {
+		m_log.add( true, intern::concatenate(
+			"Expected a different exception type. Caught: ", 
+			e.what()
+		) );
+	}
+	catch( ... ) {
+		m_log.add( true, "Expected a different exception type. "
+			"Caught unknown type." );
+	}
+}
+
+template <class Callable>
+void testbench::testcase::throws_stdexcept( Callable&& callable ) {
+	if ( m_log.aborted )
+		return;
+	try {
+		callable();
+		m_log.add( true, "No exception has been raised." );
+	}
+	catch( std::exception& e ) {
+		m_log.pass();
+	}
+	catch( ... ) {
+		m_log.add( true, "Caught unknown exception (not derived "
+			"from std::exception)" );
+	}
+}
+
+template <class Callable>
+void testbench::testcase::throws_any( Callable&& callable ) {
+	if ( m_log.aborted )
+		return;
+	try {
+		callable();
+		m_log.add( true, "No exception has been raised." );
+	}
+	catch( ... ) {
+		m_log.pass();
+	}
+}
+
+template <class Mismatch, class Header, class Describe>
+void testbench::testcase::bulk_cmp( 
+	std::size_t n, 
+	Mismatch&& mismatch, 
+	Header&& header, 
+	Describe&& describe ) 
+{
+	if ( m_log.aborted )
+		return;
+	const std::size_t block{4096};
+	const std::size_t limit = m_parent 
+		? std::max( 0, m_parent->m_policy.max_mismatches ) 
+		: 0;
+	std::size_t count{0};
+	std::vector<std::size_t> first;
+	try {
+		for( std::size_t begin{0}; begin < n; begin += block ) {
+			const std::size_t end{ std::min( n, begin + block ) };
+			std::size_t c{0};
+			for( std::size_t i{begin}; i < end; i++ ) 
+				c += mismatch( i ) ? 1 : 0;
+			count += c;
+			for( std::size_t i{begin}; c && i < end 
+				&& first.size() < limit; i++ ) 
+			{
+				if ( mismatch( i ) ) {
+					first.push_back( i );
+					c--;
+				}
+			}
+		}
+	}
+	catch( std::exception& e ) {
+		m_log.add( true, intern::concatenate(
+			"std::exception: [",
+			e.what(),
+			"]") );
+		return;
+	}
+	catch( ... ) {
+		m_log.add( true, "exception (unknown type)." );
+		return;
+	}
+	if ( !count ) {
+		m_log.pass();
+		return;
+	}
+	if ( !m_log.recording() ) {
+		m_log.add( true, "", 0 );
+		return;
+	}
+	std::string msg = intern::concatenate( 
+		count, " of ", n, " elements ", header(), "." );
+	for( std::size_t i{0}; i < first.size(); i++ ) {
+		msg += intern::concatenate( 
+			i ? "; " : " First at ", 
+			"#", first[i], ": ",
+			describe( first[i] ) );
+	}
+	if ( first.size() ) 
+		msg += ".";
+	m_log.add( true, msg );
+}
+
+template <class Iterator1, class Iterator2>
+void testbench::testcase::equal_range( 
+	Iterator1 first1, 
+	Iterator1 last1, 
+	Iterator2 first2 ) 
+{
+	bulk_cmp( 
+		last1 - first1,
+		[&]( std::size_t i ) {
+			return !( first1[i] == first2[i] );
+		},
+		[](){
+			return "differ";
+		},
+		[&]( std::size_t i ) {
+			return intern::concatenate(
+				"expected [", first2[i], "], but found [", 
+				first1[i], "]" );
+		}
+	);
+}
+
+template <class Iterator, class T>
+void testbench::testcase::all_in_range( 
+	Iterator first, 
+	Iterator last, 
+	const T& lo, 
+	const T& hi ) 
+{
+	bulk_cmp( 
+		last - first,
+		[&]( std::size_t i ) {
+			return !( first[i] >= lo && first[i] <= hi );
+		},
 		[&](){
-			return (a==b);
+			return intern::concatenate( 
+				"are not in [", lo, ", ", hi, "]" );
+		},
+		[&]( std::size_t i ) {
+			return intern::concatenate( "[", first[i], "]" );
+		}
+	);
+}
+
+template <class Container, class T>
+void testbench::testcase::all_in_range( 
+	const Container& c, 
+	const T& lo, 
+	const T& hi ) 
+{
+	all_in_range( std::begin(c), std::end(c), lo, hi );
+}
+
+template <class Container1, class Container2, class Apart, class Header>
+void testbench::testcase::bulk_near( 
+	const Container1& a, 
+	const Container2& b, 
+	Apart&& apart, 
+	Header&& header ) 
+{
+	if ( m_log.aborted )
+		return;
+	const std::size_t n = std::end(a) - std::begin(a);
+	const std::size_t m = std::end(b) - std::begin(b);
+	if ( n != m ) {
+		m_log.add( true, m_log.recording() 
+			? intern::concatenate( "Expected ", m, 
+				" elements, but found ", n, "." )
+			: std::string() );
+		return;
+	}
+	auto x = std::begin(a);
+	auto y = std::begin(b);
+	bulk_cmp( 
+		n,
+		[&]( std::size_t i ) {
+			return apart( x[i], y[i] );
+		},
+		header,
+		[&]( std::size_t i ) {
+			return intern::concatenate(
+				"expected [", y[i], "], but found [", x[i], "]" );
+		}
+	);
+}
+
+template <class Container1, class Container2, class T>
+void testbench::testcase::all_near( 
+	const Container1& a, 
+	const Container2& b, 
+	const T& th ) 
+{
+	typedef decltype( *std::begin(a) ) X;
+	typedef decltype( *std::begin(b) ) Y;
+
+	// Written as !(deviation <= th), so that NaN is a mismatch.
+	bulk_near( 
+		a, 
+		b,
+		[&]( X x, Y y ) {
+			return !( ( x > y ? x - y : y - x ) <= th );
+		},
+		[&](){
+			return intern::concatenate( 
+				"deviate by more than ", th );
+		}
+	);
+}
+
+template <class Container1, class Container2>
+void testbench::testcase::all_near_ulps( 
+	const Container1& a, 
+	const Container2& b, 
+	std::uint64_t ulps ) 
+{
+	typedef decltype( *std::begin(a) ) X;
+	typedef decltype( *std::begin(b) ) Y;
+	bulk_near( 
+		a, 
+		b,
+		[&]( X x, Y y ) {
+			return intern::is_nan(x) || intern::is_nan(y) 
+				|| intern::ulps( x, y ) > ulps;
+		},
+		[&](){
+			return intern::concatenate( 
+				"are more than ", ulps, " ulps apart" );
+		}
+	);
+}
+
+template <class Container1, class Container2, class T>
+void testbench::testcase::all_near_relative( 
+	const Container1& a, 
+	const Container2& b, 
+	T rel ) 
+{
+	typedef decltype( *std::begin(a) ) X;
+	typedef decltype( *std::begin(b) ) Y;
+	bulk_near( 
+		a, 
+		b,
+		[&]( X x, Y y ) {
+			return !intern::near_relative<T>( x, y, rel );
+		},
+		[&](){
+			return intern::concatenate( 
+				"deviate by more than rel=", rel );
+		}
+	);
+}
+
+template <class Container1, class Container2, class T>
+void testbench::testcase::all_near( 
+	const Container1& a, 
+	const Container2& b, 
+	T abs,
+	T rel ) 
+{
+	typedef decltype( *std::begin(a) ) X;
+	typedef decltype( *std::begin(b) ) Y;
+	bulk_near( 
+		a, 
+		b,
+		[&]( X x, Y y ) {
+			return !intern::near<T>( x, y, abs, rel );
+		},
+		[&](){
+			return intern::concatenate( 
+				"deviate by more than abs=", abs, ", rel=", rel );
 		}
 	);
 }
 
-template <class T>
-void testbench::testcase::equal( const T& a, const T& b, const T& th ) {
-	T diffabs = std::abs(a-b);
-	nothrow_cmp(
-		intern::concatenate(
-			"Expected [",b,"], but found [", a,
-			"]. Absolute deviation=", diffabs,
-			" exceeds threshold=", th),
-		[&](){
-			return !(diffabs > th);
-		}
-	);
+template <class...Args>
+void testbench::testcase::for_all( Args&&... args ) {
+	static_assert( sizeof...(Args) >= 2, 
+		"Requires at least one generator and a property" );
+	for_all_impl( 
+		std::forward_as_tuple( std::forward<Args>(args)... ),
+		typename make_indices<sizeof...(Args) - 1>::type() );
+}
+
+template <class Tuple, class Values, std::size_t...Is>
+bool testbench::testcase::falsifies( 
+	Tuple& t, 
+	source& src, 
+	Values& values, 
+	std::string& error, 
+	indices<Is...> ) 
+{
+	try {
+		int expand[] = { 0, 
+			( std::get<Is>(t)( src, std::get<Is>(values) ), 0 )... };
+		(void)expand;
+		return !std::get<sizeof...(Is)>(t)( std::get<Is>(values)... );
+	}
+	catch( std::exception& e ) {
+		error = intern::concatenate( "std::exception: [", e.what(), "]" );
+	}
+	catch( ... ) {
+		error = "exception (unknown type)";
+	}
+	return true;
+}
+
+template <class Tuple, std::size_t...Is>
+void testbench::testcase::for_all_impl( Tuple&& t, indices<Is...> ) {
+	typedef typename std::decay<Tuple>::type tuple_type;
+	typedef std::tuple<typename std::decay<
+		typename std::tuple_element<Is,tuple_type>::type
+		>::type::value_type...> values_type;
+	struct shard {
+		int cases;
+		bool falsified;
+		std::vector<std::uint64_t> choices;
+	};
+	if ( m_log.aborted )
+		return;
+	static const policy defaults;
+	const policy& p = m_parent ? m_parent->m_policy : defaults;
+	int n{ p.property_shards > 0 
+		? p.property_shards 
+		: int( std::thread::hardware_concurrency() ) };
+	n = std::max( 1, std::min( n, p.property_cases ) );
+	const std::uint64_t seed{ intern::seed( p.property_seed, m_log.name ) };
+	const auto start = std::chrono::steady_clock::now();
+	std::atomic<bool> cancelled{false};
+	std::vector<shard> shards( n, shard{ 0, false, {} } );
+	auto check = [&]( int k ) {
+		const int cases{ p.property_cases / n + ( k < p.property_cases % n ) };
+		source src( seed + k * 0x9e3779b97f4a7c15ull );
+		values_type values;
+		std::string error;
+		shard& r = shards[k];
+		while ( r.cases < cases && !cancelled.load( std::memory_order_relaxed ) ) {
+			if ( p.property_budget.count() && r.cases && !( r.cases & 255 )
+				&& std::chrono::steady_clock::now() - start > p.property_budget )
+				break;
+			src.generate();
+			r.cases++;
+			if ( falsifies( t, src, values, error, indices<Is...>() ) ) {
+				r.falsified = true;
+				r.choices = src.m_choices;
+				cancelled = true;
+			}
+		}
+	};
+	std::vector<std::thread> threads;
+	for( int k{1}; k < n; k++ )
+		threads.emplace_back( check, k );
+	check( 0 );
+	for( auto& thread : threads )
+		thread.join();
+	int cases{0};
+	shard* falsified{nullptr};
+	for( auto& r : shards ) {
+		cases += r.cases;
+		if ( r.falsified && !falsified )
+			falsified = &r;
+	}
+	if ( !falsified ) {
+		m_log.pass();
+		return;
+	}
+	if ( !m_log.recording() ) {
+		m_log.add( true, "", 0 );
+		return;
+	}
+	source src( seed );
+	values_type values;
+	std::string error;
+	std::vector<std::uint64_t> choices( std::move( falsified->choices ) );
+	const std::size_t steps = intern::shrink( 
+		choices, 
+		[&]( const std::vector<std::uint64_t>& candidate, 
+			std::vector<std::uint64_t>& used ) 
+		{
+			src.replay( candidate );
+			error.clear();
+			const bool f{ falsifies( t, src, values, error, indices<Is...>() ) };
+			used = src.m_choices;
+			return f;
+		},
+		p.property_shrinks );
+
+	// restores the values of the counterexample
+	src.replay( choices );
+	error.clear();
+	falsifies( t, src, values, error, indices<Is...>() );
+	std::stringstream ss;
+	int expand[] = { 0, ( ss << ( Is ? ", " : "" ), 
+		intern::print( ss, std::get<Is>(values) ), 0 )... };
+	(void)expand;
+	m_log.add( true, intern::concatenate( 
+		"Falsified after ", cases, " cases (seed=", p.property_seed, 
+		n > 1 ? intern::concatenate( ", shard=", falsified - &shards[0] ) 
+			: std::string(),
+		"), shrunk in ", steps, " steps: (", ss.str(), ")",
+		error.empty() ? "." : ", " + error + "." ) );
+}
+
+template <class Rep, class Period, class Callable>
+void testbench::testcase::completes_within( 
+	const std::chrono::duration<Rep,Period>& budget, 
+	Callable&& callable ) 
+{
+	if ( m_log.aborted )
+		return;
+	typedef std::chrono::steady_clock clock;
+	std::string msg;
+	bool failed{true};
+	auto start = clock::now();
+	try {
+		callable();
+		auto elapsed = clock::now() - start;
+		failed = elapsed > budget;
+		if ( failed )
+			msg = intern::concatenate(
+				"Expected completion within ",
+				intern::duration( budget ),
+				", but took ",
+				intern::duration( elapsed ),
+				"." );
+	}
+	catch( std::exception& e ) {
+		msg = intern::concatenate(
+			"Exception should not be thrown, but caught ",
+			e.what() );
+	}
+	catch( ... ) {
+		msg = std::string("Exception should not be thrown, but caught "
+			"exception of unknown type.");
+	}
+	m_log.add( failed, msg );
+}
+
+template <class Callable>
+void testbench::testcase::allocates_at_most( 
+	long long bytes, 
+	Callable&& callable ) 
+{
+	if ( m_log.aborted )
+		return;
+	if ( !allocations::tracked() ) {
+		m_log.add( true, "Allocations are not tracked, "
+			"define ELRAT_TESTBENCH_TRACK_ALLOCATIONS." );
+		return;
+	}
+	std::string msg;
+	bool failed{true};
+	const allocations before = allocations::current();
+	try {
+		callable();
+		const allocations& after = allocations::current();
+		failed = after.bytes - before.bytes > bytes;
+		if ( failed )
+			msg = intern::concatenate(
+				"Expected at most ",
+				bytes,
+				" bytes to be allocated, but found ",
+				after.bytes - before.bytes,
+				" bytes in ",
+				after.count - before.count,
+				" allocations." );
+	}
+	catch( std::exception& e ) {
+		msg = intern::concatenate(
+			"Exception should not be thrown, but caught ",
+			e.what() );
+	}
+	catch( ... ) {
+		msg = std::string("Exception should not be thrown, but caught "
+			"exception of unknown type.");
+	}
+	m_log.add( failed, msg );
+}
+
+template <class T>
+const T& testbench::testcase::fixture( const std::string& name ) {
+	if ( !m_parent )
+		throw std::logic_error( "Testcase without testbench." );
+	fixture_state* s{nullptr};
+	{
+		std::lock_guard<std::mutex> guard( m_parent->m_fixture_lock );
+		auto i = m_parent->m_fixtures.find( name );
+		if ( i != m_parent->m_fixtures.end() )
+			s = i->second.get();
+	}
+	if ( !s || s->type != typeid(T) )
+		throw std::logic_error( 
+			"No fixture [" + name + "] of the requested type." );
+	std::call_once( s->once, [this,s]() {
+		auto start = std::chrono::steady_clock::now();
+		s->value = s->setup();
+		s->setup_time = std::chrono::steady_clock::now() - start;
+		std::lock_guard<std::mutex> guard( m_parent->m_fixture_lock );
+		m_parent->m_set_up.push_back( s );
+	} );
+	return *static_cast<const T*>( s->value.get() );
+}
+
+inline void testbench::testcase::matches_golden( 
+	const std::string& name, 
+	const void* data, 
+	std::size_t size ) 
+{
+	if ( m_log.aborted )
+		return;
+	const std::string path = m_parent 
+		&& !m_parent->m_policy.golden_directory.empty()
+		? m_parent->m_policy.golden_directory + '/' + name 
+		: name;
+	const bool update = m_parent 
+		? m_parent->m_policy.update_goldens
+		: intern::enabled( "ELRAT_TESTBENCH_UPDATE_GOLDENS" );
+	const char* bytes = static_cast<const char*>( data );
+	const std::size_t chunk{ 1 << 16 };
+	const std::size_t context{8}; // bytes before and after the difference
+	bool exists{false};
+	std::size_t golden_size{0};
+	std::size_t offset{0};
+	std::string expected;
+	std::string found;
+	try {
+		mapping golden( path );
+		exists = golden.is_open();
+		if ( exists ) {
+			golden_size = golden.size();
+			const std::size_t common{ std::min( size, golden_size ) };
+			std::size_t n;
+			for( ; offset < common; offset += n ) {
+				n = std::min( chunk, common - offset );
+				const char* g = golden.view( offset, n );
+				if ( std::memcmp( g, bytes + offset, n ) ) {
+					offset += std::mismatch( g, g + n, bytes + offset ).first 
+						- g;
+					break;
+				}
+			}
+			if ( offset == common && size == golden_size ) {
+				m_log.pass();
+				return;
+			}
+			if ( !update && m_log.recording() ) {
+				const std::size_t from{ offset - std::min( offset, context ) };
+				const std::size_t end{ offset + context + 1 };
+				const std::size_t g{ std::min( golden_size, end ) - from };
+				const std::size_t a{ std::min( size, end ) - from };
+				if ( g )
+					expected = intern::hex( 
+						golden.view( from, g ), g, offset - from );
+				found = intern::hex( bytes + from, a, offset - from );
+			}
+		}
+	}
+	catch( std::exception& e ) {
+		m_log.add( true, intern::concatenate(
+			"std::exception: [",
+			e.what(),
+			"]") );
+		return;
+	}
+	if ( update ) {
+		if ( intern::replace_file( path, bytes, size ) )
+			m_log.pass();
+		else
+			m_log.add( true, intern::concatenate( 
+				"Cannot write golden file [", path, "]." ) );
+	}
+	else if ( !m_log.recording() )
+		m_log.add( true, "", 0 );
+	else if ( !exists ) 
+		m_log.add( true, intern::concatenate( 
+			"Golden file [", path, "] doesn't exist." ) );
+	else {
+		std::string msg = intern::concatenate( 
+			"Golden file [", path, "] differs at offset ", offset, "." );
+		if ( size != golden_size )
+			msg += intern::concatenate( 
+				" Size is ", size, ", but should be ", golden_size, "." );
+		msg += intern::concatenate( 
+			" Expected [", expected, "], but found [", found, "]." );
+		m_log.add( true, msg );
+	}
+}
+
+template <class Bytes>
+void testbench::testcase::matches_golden( 
+	const std::string& name, 
+	const Bytes& bytes ) 
+{
+	matches_golden( 
+		name, 
+		bytes.data(), 
+		bytes.size() * sizeof( *bytes.data() ) );
+}
+
+//
+// testbench::source
+// testbench::integers
+// testbench::floats
+// testbench::strings
+// testbench::vectors
+//
+template <class Generator>
+testbench::vectors<Generator> testbench::vectors_of( 
+	const Generator& g, 
+	std::size_t max_size ) 
+{
+	return vectors<Generator>( g, max_size );
+}
+
+inline testbench::source::source( std::uint64_t seed )
+: m_prefix{nullptr} {
+	// splitmix64
+	for( auto& s : m_state ) {
+		std::uint64_t z{ seed += 0x9e3779b97f4a7c15ull };
+		z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9ull;
+		z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111ebull;
+		s = z ^ ( z >> 31 );
+	}
+}
+
+inline std::uint64_t testbench::source::next() {
+	auto rotl = []( std::uint64_t x, int k ) {
+		return ( x << k ) | ( x >> ( 64 - k ) );
+	};
+	const std::uint64_t result{ rotl( m_state[1] * 5, 7 ) * 9 };
+	const std::uint64_t t{ m_state[1] << 17 };
+	m_state[2] ^= m_state[0];
+	m_state[3] ^= m_state[1];
+	m_state[1] ^= m_state[2];
+	m_state[0] ^= m_state[3];
+	m_state[2] ^= t;
+	m_state[3] = rotl( m_state[3], 45 );
+	return result;
+}
+
+inline void testbench::source::generate() {
+	m_prefix = nullptr;
+	m_choices.clear();
+}
+
+inline void testbench::source::replay( 
+	const std::vector<std::uint64_t>& prefix ) 
+{
+	m_prefix = &prefix;
+	m_choices.clear();
+}
+
+inline std::uint64_t testbench::source::draw( std::uint64_t bound ) {
+	std::uint64_t c;
+	if ( m_prefix ) {
+		c = m_choices.size() < m_prefix->size() 
+			? std::min( (*m_prefix)[ m_choices.size() ], bound ) 
+			: 0;
+	}
+	else {
+		c = next();
+		if ( bound != std::numeric_limits<std::uint64_t>::max() )
+			c %= bound + 1;
+	}
+	m_choices.push_back( c );
+	return c;
+}
+
+template <class T>
+testbench::integers<T>::integers( T lo, T hi ) 
+: m_lo{lo}, m_hi{hi} {
+	if ( hi < lo )
+		throw std::invalid_argument( "integers: hi < lo" );
+}
+
+template <class T>
+void testbench::integers<T>::operator()( source& s, T& out ) const {
+	typedef typename std::make_unsigned<T>::type U;
+
+	// The bounds are frequent edge cases, so the bound farthest from zero
+	// is chosen now and then. The choices of the regular value are drawn 
+	// anyway, so that shrinking the first choice yields a similar value.
+	const bool edge{ s.draw(15) == 15 };
+	if ( !( m_lo < 0 ) )
+		out = T( U( U(m_lo) + s.draw( U( U(m_hi) - U(m_lo) ) ) ) );
+	else if ( !( m_hi > 0 ) )
+		out = T( U( U(m_hi) - s.draw( U( U(m_hi) - U(m_lo) ) ) ) );
+	else if ( !s.draw(1) )
+		out = T( s.draw( U(m_hi) ) );
+	else 
+		out = T( U( U(0) - U(1) - s.draw( U( U(0) - U(m_lo) - U(1) ) ) ) );
+	if ( edge )
+		out = out < 0 || !( m_hi > 0 ) ? m_lo : m_hi;
+}
+
+template <class T>
+testbench::floats<T>::floats( T lo, T hi ) 
+: m_lo{lo}, m_hi{hi} {
+	if ( !( lo <= hi ) || !std::isfinite(lo) || !std::isfinite(hi) )
+		throw std::invalid_argument( "floats: requires finite lo <= hi" );
+}
+
+template <class T>
+void testbench::floats<T>::operator()( source& s, T& out ) const {
+	// see 'integers'
+	const bool edge{ s.draw(15) == 15 };
+	double u{ double( s.draw( ( 1ull << 53 ) - 1 ) ) / ( 1ull << 53 ) };
+	if ( edge )
+		u = 1.0;
+	if ( !( m_lo < 0 ) )
+		out = T( m_lo + u * ( double(m_hi) - m_lo ) );
+	else if ( !( m_hi > 0 ) )
+		out = T( m_hi - u * ( double(m_hi) - m_lo ) );
+	else if ( !s.draw(1) )
+		out = T( u * m_hi );
+	else 
+		out = T( u * m_lo );
+	out = std::min( m_hi, std::max( m_lo, out ) );
+}
+
+inline testbench::strings::strings( 
+	std::size_t max_length, 
+	const std::string& alphabet )
+: m_max_length{max_length}, m_alphabet{alphabet} {
+	if ( alphabet.empty() )
+		throw std::invalid_argument( "strings: empty alphabet" );
+}
+
+inline void testbench::strings::operator()( 
+	source& s, 
+	std::string& out ) const 
+{
+	out.clear();
+	while ( out.size() < m_max_length && s.draw(7) )
+		out += m_alphabet[ s.draw( m_alphabet.size() - 1 ) ];
+}
+
+template <class Generator>
+testbench::vectors<Generator>::vectors( 
+	const Generator& g, 
+	std::size_t max_size )
+: m_element(g), m_max_size{max_size} {
+
+}
+
+template <class Generator>
+void testbench::vectors<Generator>::operator()( 
+	source& s, 
+	value_type& out ) const 
+{
+	// Each element is preceded by a choice to continue, so that shrinking
+	// can delete elements by deleting their choices.
+	std::size_t n{0};
+	while ( n < m_max_size && s.draw(7) ) {
+		if ( n == out.size() )
+			out.emplace_back();
+		m_element( s, out[n++] );
+	}
+	out.resize( n );
+}
+
+//
+// testbench::allocations
+//
+inline testbench::allocations& testbench::allocations::current() {
+	static thread_local allocations a = { 0, 0 };
+	return a;
+}
+
+inline bool& testbench::allocations::tracked() {
+	static bool t{false};
+	return t;
+}
+
+//
+// testbench::log 
+// testbench::log::entry
+//
+
+inline testbench::log::log( const std::string& s )
+: pool{nullptr}
+, name{s}
+, check_count{0}
+, failed_count{0}
+, aborted{false}
+, max_failed_checks{0}
+, max_entries{0} {
+
+}
+
+inline void testbench::log::add( bool failed, const std::string& msg ) {
+	add( failed, msg.data(), msg.size() );
+}
+
+inline void testbench::log::add( bool failed, const char* msg ) {
+	add( failed, msg, failed ? std::strlen( msg ) : 0 );
+}
+
+inline void testbench::log::add( 
+	bool failed, 
+	const char* msg, 
+	std::size_t size ) 
+{
+	if ( !failed ) {
+		pass();
+		return;
+	}
+	if ( aborted )
+		return;
+	check_count++;
+#if ELRAT_TESTBENCH_CHECKS == ELRAT_TESTBENCH_CHECKS_COUNT
+	(void) msg;
+	(void) size;
+#else
+	if ( !max_entries || failed_count < max_entries ) {
+		// A few entries are reserved at once, instead of growing the 
+		// vector with each of the first failed checks.
+		if ( !entries.capacity() )
+			entries.reserve( max_entries ? std::min( max_entries, 16 ) : 16 );
+		arena::text t;
+		if ( !pool || pool->store( msg, size, t ) )
+			entries.push_back( entry( check_count, pool, t ) );
+	}
+#endif
+	failed_count++;
+	if ( max_failed_checks && failed_count >= max_failed_checks )
+		aborted = true;
+}
+
+inline void testbench::log::pass() {
+#if ELRAT_TESTBENCH_CHECKS != ELRAT_TESTBENCH_CHECKS_NONE
+	if ( !aborted )
+		check_count++;
+#endif
+}
+
+inline bool testbench::log::recording() const {
+#if ELRAT_TESTBENCH_CHECKS == ELRAT_TESTBENCH_CHECKS_COUNT
+	return false;
+#else
+	return ( !max_entries || failed_count < max_entries ) 
+		&& ( !pool || pool->accepting() );
+#endif
+}
+
+inline testbench::log::entry::entry( 
+	int pos, 
+	const arena* p, 
+	const arena::text& msg )
+: position{pos}, pool{p}, text(msg) {
+
+}
+
+inline std::string testbench::log::entry::message() const {
+	return pool ? pool->read( text ) : std::string();
+}
+
+//
+// testbench::arena
+//
+inline testbench::arena::text::text()
+: chunk{0}, data{nullptr}, size{0} {
+
+}
+
+inline testbench::arena::arena()
+: m_first{0}
+, m_bytes{0}
+, m_limit{0}
+, m_drop_oldest{false}
+, m_full{false}
+, m_dropped{0} {
+
+}
+
+inline void testbench::arena::limit( std::size_t bytes, bool drop_oldest ) {
+	std::lock_guard<std::mutex> guard( m_lock );
+	m_limit = bytes;
+	m_drop_oldest = drop_oldest;
+	m_full = false;
+}
+
+inline bool testbench::arena::accepting() const {
+	return !m_full.load( std::memory_order_relaxed );
+}
+
+inline bool testbench::arena::store( const std::string& s, text& t ) {
+	return store( s.data(), s.size(), t );
+}
+
+inline bool testbench::arena::store( 
+	const char* s, 
+	std::size_t size, 
+	text& t ) 
+{
+	t = text();
+	std::lock_guard<std::mutex> guard( m_lock );
+	if ( m_full ) {
+		m_dropped++;
+		return false;
+	}
+	if ( !size )
+		return true;
+	if ( m_chunks.empty() 
+		|| m_chunks.back().capacity - m_chunks.back().used < size ) 
+	{
+		// The chunks grow up to ChunkSize, so that an arena with only
+		// a few messages stays small.
+		std::size_t capacity = std::max<std::size_t>( 1024, m_bytes );
+		if ( capacity > ChunkSize )
+			capacity = ChunkSize;
+		if ( m_limit && m_limit < capacity )
+			capacity = m_limit;
+		capacity = std::max( capacity, size );
+		if ( m_limit && capacity > m_limit ) {
+			m_dropped++;
+			return false;
+		}
+		while( m_limit && m_bytes + capacity > m_limit ) {
+			if ( !m_drop_oldest ) {
+				m_full = true;
+				m_dropped++;
+				return false;
+			}
+			m_bytes -= m_chunks.front().capacity;
+			m_dropped += m_chunks.front().messages;
+			m_chunks.pop_front();
+			m_first++;
+		}
+		chunk c;
+		c.data.reset( new char[capacity] );
+		c.capacity = capacity;
+		c.used = 0;
+		c.messages = 0;
+		m_chunks.push_back( std::move(c) );
+		m_bytes += capacity;
+	}
+	chunk& c = m_chunks.back();
+	std::copy( s, s + size, c.data.get() + c.used );
+	t.chunk = m_first + m_chunks.size() - 1;
+	t.data = c.data.get() + c.used;
+	t.size = size;
+	c.used += size;
+	c.messages++;
+	return true;
+}
+
+inline std::string testbench::arena::read( const text& t ) const {
+	if ( !t.size ) 
+		return std::string();
+	std::lock_guard<std::mutex> guard( m_lock );
+	if ( t.chunk < m_first )
+		return std::string("[message dropped]");
+	return std::string( t.data, t.size );
+}
+
+inline std::size_t testbench::arena::dropped() const {
+	std::lock_guard<std::mutex> guard( m_lock );
+	return m_dropped;
+}
+
+//
+// testbench::intern
+//
+template <class...Args>
+std::string testbench::intern::concatenate( const Args&... args ) {
+	try {
+		std::string buffer( take_buffer() );
+		int expand[] = { 0, ( append( buffer, args ), 0 )... };
+		(void)expand;
+		return give_back( buffer );
+	} 
+	catch( ... ) {
+
+	}
+	return std::string("[Creating feedback message failed due to an"
+		"exception]");
+}
+
+template <std::size_t N, class...Args> 
+std::string testbench::intern::format( 
+	arity<N>, 
+	const char* fmt, 
+	const Args&... args ) 
+{
+	static_assert( N == sizeof...(Args), 
+		"Number of placeholders and arguments differ." );
+	try {
+		std::string buffer( take_buffer() );
+		auto next = [&]() {
+			const char* p = std::strstr( fmt, "{}" );
+			buffer.append( fmt, p - fmt );
+			fmt = p + 2;
+		};
+		int expand[] = { 0, ( next(), append( buffer, args ), 0 )... };
+		(void)expand;
+		buffer.append( fmt );
+		return give_back( buffer );
+	} 
+	catch( ... ) {
+
+	}
+	return std::string("[Creating feedback message failed due to an"
+		"exception]");
 }
 
-template <class T>
-void testbench::testcase::less_than( const T& a, const T& b ) {
-	nothrow_cmp(
-		intern::concatenate(
-			"Expected value to be less than [",b,
-			"], but found [",a,"]."),
-		[&](){
-			return a < b;
-		}
-	);
+inline std::string& testbench::intern::thread_buffer() {
+	static thread_local std::string buffer;
+	return buffer;
 }
 
-template <class T>
-void testbench::testcase::less_than_or_equal( const T& a, const T& b ) {
-	nothrow_cmp(
-		intern::concatenate(
-			"Expected value to be less than or equal to [",b,
-			"], but found [",a,"]."),
-		[&](){
-			return a <= b;
-		}
-	);
+inline std::string testbench::intern::take_buffer() {
+	std::string buffer;
+	buffer.swap( thread_buffer() );
+	buffer.clear();
+	return buffer;
 }
 
-template <class T>
-void testbench::testcase::greater_than( const T& a, const T& b ) {
-	nothrow_cmp(
-		intern::concatenate( 
-			"Expected value to be greater than [",b,
-			"], but found [",a,"]."),
-		[&](){
-			return a > b;
-		}
-	);
+inline std::string testbench::intern::give_back( std::string& buffer ) {
+	std::string result( buffer );
+	buffer.swap( thread_buffer() );
+	return result;
 }
 
-template <class T>
-void testbench::testcase::greater_than_or_equal( const T& a, const T& b ) {
-	nothrow_cmp( 
-		intern::concatenate( 
-			"Expected value to be greater than or equal to [",b,
-			"], but found [",a,"]."),
-		[&](){
-			return a >= b;
-		}
-	);
+template <class T> 
+void testbench::intern::append( std::string& out, const T& t ) {
+	typedef typename std::decay<T>::type D;
+	append( out, t, kind<
+		std::is_same<D,bool>::value ? 0 :
+		std::is_same<D,char>::value 
+			|| std::is_same<D,signed char>::value
+			|| std::is_same<D,unsigned char>::value ? 1 :
+		std::is_integral<D>::value ? 2 :
+		std::is_floating_point<D>::value ? 3 :
+		std::is_convertible<const T&, const char*>::value ? 4 :
+		std::is_same<D,std::string>::value ? 5 : 6>() );
 }
 
-template <class T>
-void testbench::testcase::in_range( const T& a, const T& lo, const T& hi ) {
-	nothrow_cmp(
-		intern::concatenate(
-			"Expected value in [",lo,", ",hi,
-			"], but found [",a,"]."),
-		[&](){
-			return ( a >= lo && a <= hi );
-		}
-	);
+inline void testbench::intern::append( std::string& out, bool b, kind<0> ) {
+	out += b ? '1' : '0';
 }
 
-template <class T>
-void testbench::testcase::not_in_range(const T& a, const T& lo, const T& hi) {
-	nothrow_cmp(
-		intern::concatenate(
-			"Expected value to be less that [",lo,
-			"] or greater than [",hi,
-			"], but found [",a,"]."),
-		[&](){
-			return ( a < lo || a > hi );
-		}
-	);
+inline void testbench::intern::append( std::string& out, char c, kind<1> ) {
+	out += c;
 }
 
-template <class Callable>
-void testbench::testcase::does_not_throw( Callable&& callable ) {
-	static const std::string msg1(
-		"Exception should not be thrown, but caught ");
-	std::string msg2;
-	bool thrown{true};
-	try {
-		callable();
-		thrown = false;
-	}
-	catch( std::exception& e ) {
-		msg2 = std::string(e.what());
+template <class T> 
+void testbench::intern::append( std::string& out, T t, kind<2> ) {
+	typedef typename std::make_unsigned<T>::type U;
+	static const char pairs[] = 
+		"0001020304050607080910111213141516171819202122232425262728293031323334353637383940414243444546474849"
+		"5051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+	char digits[24];
+	char* end = digits + sizeof(digits);
+	char* p = end;
+	const bool negative{ t < T(1) && t != T(0) };
+	U u = negative ? U( U(0) - U(t) ) : U(t);
+	while ( u >= 100 ) {
+		const std::size_t i = std::size_t( u % 100 ) * 2;
+		u /= 100;
+		*--p = pairs[i + 1];
+		*--p = pairs[i];
 	}
-	catch( ... ) {
-		msg2 = std::string("exception of unknown type.");
+	if ( u >= 10 ) {
+		const std::size_t i = std::size_t( u ) * 2;
+		*--p = pairs[i + 1];
+		*--p = pairs[i];
 	}
-	m_log.add( thrown , msg1+msg2 );
+	else
+		*--p = char( '0' + u );
+	if ( negative )
+		*--p = '-';
+	out.append( p, end - p );
 }
 
-// Problem: When template parameter Exception is of type std::exception, the 
-// 	compiler warns about the exception be caught earlier, in the 
-// 	catch-statement before. I don't want to turn warnings off. The library
-// 	should compile and work without any sharp edges to it.
-//
-// Solution attempts:
-// - Partial template specialization (Exception=std::std::exception), but it's
-// 	not allowed. A full template specialization seems not possible because
-// 	of the template parameter 'Callable'.
-// - Used the approach of 
-// 	[if constexpr std::is_same<Exception,std::exception>::value], 
-// 	but this requires C++17, which I don't want to enforce at the moment.
-//
-// Current solution:
-// - If it's irrelevant what type of exception is thrown, use 'throws_any'.
-// - If *any* std::exception is expected, use 'throws_stdexcept'
-// - If one specific exception type, which can also be a derivative of 
-// 	std::exception, is expected, then use 'throws', 
-// 	e.g. 'throws<std::range_error>'.
-template <class Exception, class Callable>
-void testbench::testcase::throws( Callable&& callable ) {
-	static_assert( !std::is_same<Exception,std::exception>::value, 
-		"Sorry for the inconvenience, but may I refer you"
-		"to 'throws_stdexcept()' instead!" );
-	std::string msg;
-	bool failed{true};
-	try {
-		callable();
-		msg = std::string("No exception has been raised.");
-	}
-	catch( Exception& e ) {
-		failed = false;
+template <class T> 
+void testbench::intern::append( std::string& out, T t, kind<3> ) {
+	// same as the default format of streams
+	char digits[64];
+	const int n = std::snprintf( digits, sizeof(digits), "%Lg", 
+		static_cast<long double>( t ) );
+	if ( n > 0 )
+		out.append( digits, std::min<std::size_t>( n, sizeof(digits) - 1 ) );
+}
+
+inline void testbench::intern::append( 
+	std::string& out, 
+	const char* s, 
+	kind<4> ) 
+{
+	if ( s )
+		out += s;
+}
+
+inline void testbench::intern::append( 
+	std::string& out, 
+	const std::string& s, 
+	kind<5> ) 
+{
+	out += s;
+}
+
+template <class T> 
+void testbench::intern::append( std::string& out, const T& t, kind<6> ) {
+	static thread_local std::ostringstream os;
+	os.str( std::string() );
+	os.clear();
+	os << t;
+	out += os.str();
+}
+
+inline void testbench::intern::serialize( const log& l, std::string& out ) {
+	auto put = [&out]( const void* data, std::size_t size ) {
+		out.append( static_cast<const char*>(data), size );
+	};
+	const std::size_t start{ out.size() };
+	std::uint32_t size{0};
+	put( &size, sizeof(size) );
+	const std::int32_t counts[] = { l.check_count, l.failed_count };
+	put( counts, sizeof(counts) );
+	const char aborted = l.aborted;
+	put( &aborted, 1 );
+	const std::int64_t used[] = { 
+		l.used.wall_time.count(), 
+		l.used.cpu_time.count(), 
+		l.used.allocations, 
+		l.used.allocated_bytes };
+	put( used, sizeof(used) );
+	const std::uint32_t entries = l.entries.size();
+	put( &entries, sizeof(entries) );
+	for( auto& e : l.entries ) {
+		const std::string msg{ e.message() };
+		const std::int32_t position = e.position;
+		const std::uint32_t length = msg.size();
+		put( &position, sizeof(position) );
+		put( &length, sizeof(length) );
+		put( msg.data(), msg.size() );
 	}
-	catch( std::exception& e ) {
-		msg = intern::concatenate(
-			"Expected a different exception type. Caught: ", 
-			e.what()
-		);
+	size = out.size() - start - sizeof(size);
+	std::memcpy( &out[start], &size, sizeof(size) );
+}
+
+inline bool testbench::intern::deserialize( const std::string& in, log& l ) {
+	std::size_t pos{0};
+	auto get = [&]( void* data, std::size_t size ) {
+		if ( pos + size > in.size() ) 
+			return false;
+		std::memcpy( data, in.data() + pos, size );
+		pos += size;
+		return true;
+	};
+	std::uint32_t size;
+	std::int32_t counts[2];
+	char aborted;
+	std::int64_t used[4];
+	std::uint32_t entries;
+	if ( !get( &size, sizeof(size) ) || !get( counts, sizeof(counts) ) 
+		|| !get( &aborted, 1 ) || !get( used, sizeof(used) ) 
+		|| !get( &entries, sizeof(entries) ) ) 
+		return false;
+	l.check_count = counts[0];
+	l.failed_count = counts[1];
+	l.aborted = aborted;
+	l.used.wall_time = std::chrono::nanoseconds( used[0] );
+	l.used.cpu_time = std::chrono::nanoseconds( used[1] );
+	l.used.allocations = used[2];
+	l.used.allocated_bytes = used[3];
+	for( std::uint32_t i{0}; i < entries; i++ ) {
+		std::int32_t position;
+		std::uint32_t length;
+		if ( !get( &position, sizeof(position) ) 
+			|| !get( &length, sizeof(length) ) 
+			|| pos + length > in.size() ) 
+			return false;
+		arena::text t;
+		if ( !l.pool || l.pool->store( in.substr( pos, length ), t ) )
+			l.entries.push_back( log::entry( position, l.pool, t ) );
+		pos += length;
 	}
-	catch( ... ) {
-		msg = std::string("Expected a different exception type."
-			"Caught unknown type.");
+	return true;
+}
+
+inline bool testbench::intern::read_all( 
+	int fd, 
+	void* data, 
+	std::size_t size ) 
+{
+#ifdef ELRAT_TESTBENCH_FORK
+	char* p = static_cast<char*>( data );
+	while( size ) {
+		const ssize_t n = ::read( fd, p, size );
+		if ( n < 0 && errno == EINTR ) 
+			continue;
+		if ( n <= 0 ) 
+			return false;
+		p += n;
+		size -= n;
 	}
-	m_log.add( failed, msg );
+	return true;
+#else
+	return false;
+#endif
 }
 
-template <class Callable>
-void testbench::testcase::throws_stdexcept( Callable&& callable ) {
-	std::string msg;
-	bool failed{true};
-	try {
-		callable();
-		msg = std::string("No exception has been raised.");
+inline bool testbench::intern::write_all( 
+	int fd, 
+	const void* data, 
+	std::size_t size ) 
+{
+#ifdef ELRAT_TESTBENCH_FORK
+	const char* p = static_cast<const char*>( data );
+	while( size ) {
+		const ssize_t n = ::write( fd, p, size );
+		if ( n < 0 && errno == EINTR ) 
+			continue;
+		if ( n <= 0 ) 
+			return false;
+		p += n;
+		size -= n;
 	}
-	catch( std::exception& e ) {
-		failed = false;
+	return true;
+#else
+	return false;
+#endif
+}
+
+inline std::string testbench::intern::json_escape( const std::string& s ) {
+	static const char* hex = "0123456789abcdef";
+	std::string result;
+	result.reserve( s.size() );
+	for( char c : s ) {
+		switch( c ) {
+			case '\"': result += "\\\""; break;
+			case '\\': result += "\\\\"; break;
+			case '\n': result += "\\n"; break;
+			case '\r': result += "\\r"; break;
+			case '\t': result += "\\t"; break;
+			default:
+				if ( static_cast<unsigned char>(c) < 0x20 ) {
+					result += "\\u00";
+					result += hex[ (c >> 4) & 0xf ];
+					result += hex[ c & 0xf ];
+				}
+				else
+					result += c;
+		}
 	}
-	catch( ... ) {
-		msg = std::string("Caught unknown exception (not derived"
-			"from std::exception)");
+	return result;
+}
+
+inline std::string testbench::intern::xml_escape( const std::string& s ) {
+	std::string result;
+	result.reserve( s.size() );
+	for( char c : s ) {
+		switch( c ) {
+			case '&': result += "&amp;"; break;
+			case '<': result += "&lt;"; break;
+			case '>': result += "&gt;"; break;
+			case '\"': result += "&quot;"; break;
+			case '\'': result += "&apos;"; break;
+			default: result += c;
+		}
 	}
-	m_log.add( failed, msg );
+	return result;
 }
 
-template <class Callable>
-void testbench::testcase::throws_any( Callable&& callable ) {
-	std::string msg;
-	bool failed{true};
-	try {
-		callable();
-		msg = std::string("No exception has been raised.");
+inline std::chrono::nanoseconds testbench::intern::thread_cpu_time() {
+#ifdef ELRAT_TESTBENCH_FORK
+	timespec ts;
+	if ( !::clock_gettime( CLOCK_THREAD_CPUTIME_ID, &ts ) ) 
+		return std::chrono::seconds( ts.tv_sec ) 
+			+ std::chrono::nanoseconds( ts.tv_nsec );
+#endif
+	// process time as fallback
+	return std::chrono::nanoseconds( static_cast<long long>( 
+		1e9 * std::clock() / CLOCKS_PER_SEC ) );
+}
+
+template <class Fails>
+std::size_t testbench::intern::shrink( 
+	std::vector<std::uint64_t>& choices, 
+	Fails&& fails, 
+	int attempts ) 
+{
+	static const std::size_t chunks[] = { 8, 4, 3, 2, 1 };
+	std::size_t steps{0};
+	std::vector<std::uint64_t> candidate;
+	std::vector<std::uint64_t> used;
+
+	// A candidate is accepted if it still fails and is simpler, i.e. 
+	// shorter or lexicographically smaller.
+	auto attempt = [&]() {
+		if ( attempts <= 0 )
+			return false;
+		attempts--;
+		if ( !fails( candidate, used ) 
+			|| used.size() > choices.size() 
+			|| ( used.size() == choices.size() && !( used < choices ) ) )
+			return false;
+		choices.swap( used );
+		steps++;
+		return true;
+	};
+	bool improved{true};
+	while ( improved && attempts > 0 ) {
+		improved = false;
+		for( auto k : chunks ) {
+			for( std::size_t i{0}; i + k <= choices.size(); ) {
+				candidate.assign( choices.begin(), choices.begin() + i );
+				candidate.insert( candidate.end(), 
+					choices.begin() + i + k, choices.end() );
+				if ( attempt() )
+					improved = true;
+				else
+					i++;
+			}
+		}
+		for( auto k : chunks ) {
+			for( std::size_t i{0}; i + k <= choices.size(); i++ ) {
+				if ( std::all_of( choices.begin() + i, choices.begin() + i + k,
+					[]( std::uint64_t c ) { return c == 0; } ) )
+					continue;
+				candidate = choices;
+				std::fill( candidate.begin() + i, candidate.begin() + i + k, 0 );
+				if ( attempt() )
+					improved = true;
+			}
+		}
+		for( std::size_t i{0}; i < choices.size(); i++ ) {
+			std::uint64_t lo{0};
+			while ( i < choices.size() && lo < choices[i] ) {
+				const std::uint64_t mid{ lo + ( choices[i] - lo ) / 2 };
+				candidate = choices;
+				candidate[i] = mid;
+				if ( attempt() )
+					improved = true;
+				else
+					lo = mid + 1;
+			}
+		}
 	}
-	catch( ... ) {
-		failed = false;
+	return steps;
+}
+
+inline std::uint64_t testbench::intern::seed( 
+	std::uint64_t seed, 
+	const std::string& name ) 
+{
+	// FNV-1a
+	std::uint64_t h{ 0xcbf29ce484222325ull };
+	for( unsigned char c : name )
+		h = ( h ^ c ) * 0x100000001b3ull;
+	return seed ^ h;
+}
+
+template <class T>
+void testbench::intern::print( std::ostream& os, const T& t ) {
+	os << t;
+}
+
+inline void testbench::intern::print( std::ostream& os, const std::string& s ) {
+	os << '"' << s << '"';
+}
+
+template <class T>
+void testbench::intern::print( std::ostream& os, const std::vector<T>& v ) {
+	os << '{';
+	for( std::size_t i{0}; i < v.size(); i++ ) {
+		if ( i )
+			os << ", ";
+		print( os, v[i] );
 	}
-	m_log.add( failed, msg );
+	os << '}';
 }
 
-//
-// testbench::log 
-// testbench::log::entry
-//
+template <class T> 
+bool testbench::intern::is_nan( const T& t ) {
+	return std::is_floating_point<T>::value && !( t == t );
+}
 
-testbench::log::log( const std::string& s )
-: name{s}, check_count{0} {
+template <class T> 
+std::uint64_t testbench::intern::ulps( T a, T b ) {
+	static_assert( 
+		std::is_floating_point<T>::value 
+			&& ( sizeof(T) == 4 || sizeof(T) == 8 ), 
+		"Requires float or double" );
+	typedef typename std::conditional< 
+		sizeof(T) == 4, 
+		std::uint32_t, 
+		std::uint64_t>::type bits;
+	if ( is_nan(a) || is_nan(b) )
+		return std::numeric_limits<std::uint64_t>::max();
+	if ( a == b )
+		return 0;
 
+	// Maps the sign-magnitude representation onto unsigned integers, which
+	// are ordered like the floating-point values.
+	const bits sign{ bits(1) << ( sizeof(T) * 8 - 1 ) };
+	bits x, y;
+	std::memcpy( &x, &a, sizeof(T) );
+	std::memcpy( &y, &b, sizeof(T) );
+	x = ( x & sign ) ? bits( sign - ( x & ~sign ) ) : bits( x | sign );
+	y = ( y & sign ) ? bits( sign - ( y & ~sign ) ) : bits( y | sign );
+	return x > y ? x - y : y - x;
 }
 
-void testbench::log::add( bool failed, const std::string& msg ) {
-	check_count++;
-	if ( failed ) 
-		entries.push_back( entry( check_count, msg ) );
+template <class T> 
+bool testbench::intern::near_relative( T a, T b, T rel ) {
+	static_assert( std::is_floating_point<T>::value, 
+		"Requires float or double" );
+	if ( a == b )
+		return true;
+	const T m{ std::max( std::fabs(a), std::fabs(b) ) };
+	return std::fabs( a - b ) <= rel * m;
 }
 
-testbench::log::entry::entry( int pos, std::string msg )
-: position{pos}, message{msg} {
+template <class T> 
+bool testbench::intern::near( T a, T b, T abs, T rel ) {
+	static_assert( std::is_floating_point<T>::value, 
+		"Requires float or double" );
+	if ( a == b )
+		return true;
+	const T d{ std::fabs( a - b ) };
+	return d <= abs || d <= rel * std::max( std::fabs(a), std::fabs(b) );
+}
 
+inline std::string testbench::intern::hex( 
+	const char* p, 
+	std::size_t n, 
+	std::size_t mark ) 
+{
+	static const char Digits[] = "0123456789abcdef";
+	std::string s;
+	for( std::size_t i{0}; i < n; i++ ) {
+		const unsigned char c = static_cast<unsigned char>( p[i] );
+		if ( i ) 
+			s += ' ';
+		if ( i == mark ) 
+			s += '(';
+		s += Digits[c >> 4];
+		s += Digits[c & 15];
+		if ( i == mark ) 
+			s += ')';
+	}
+	return s;
 }
 
-//
-// testbench::intern
-//
-template <class Arg>
-std::string testbench::intern::write_to_stream( 
-	std::stringstream& ss, 
-	Arg last ) 
+inline bool testbench::intern::replace_file( 
+	const std::string& path, 
+	const char* data, 
+	std::size_t size ) 
 {
-	ss << last;
-	return std::string( ss.str() );
+	const std::string temporary( path + ".tmp" );
+	{
+		std::ofstream file( temporary.c_str(), std::ios::binary );
+		if ( !file.write( data, static_cast<std::streamsize>( size ) ) 
+			|| !file.flush() ) 
+		{
+			file.close();
+			std::remove( temporary.c_str() );
+			return false;
+		}
+	}
+	if ( std::rename( temporary.c_str(), path.c_str() ) ) {
+		std::remove( temporary.c_str() );
+		return false;
+	}
+	return true;
+}
+
+inline bool testbench::intern::enabled( const char* variable ) {
+	const char* value = std::getenv( variable );
+	return value && *value && std::strcmp( value, "0" );
 }
 
-template <class Arg, class... Args>
-std::string testbench::intern::write_to_stream( 
-	std::stringstream& ss, 
-	Arg current, 
-	Args... rest )
+inline std::string testbench::intern::duration( std::chrono::nanoseconds ns ) {
+	static const char* units[] = { "ns", "us", "ms", "s" };
+	double value = static_cast<double>( ns.count() );
+	int unit{0};
+	for( ; unit < 3 && std::abs(value) >= 1000.0; unit++ ) 
+		value /= 1000.0;
+	std::stringstream ss;
+	ss << std::fixed << std::setprecision( unit ? 2 : 0 ) 
+		<< value << ' ' << units[unit];
+	return ss.str();
+}
+
+inline double testbench::intern::mann_whitney( 
+	const std::vector<double>& a, 
+	const std::vector<double>& b ) 
 {
-	ss << current;
-	return write_to_stream( ss, rest... );
+	const double n1 = a.size();
+	const double n2 = b.size();
+	if ( !a.size() || !b.size() ) 
+		return 1.0;
+	
+	// rank all values, tied values get the average of their ranks
+	std::vector<std::pair<double,bool>> all;
+	for( auto x : a ) 
+		all.push_back( std::make_pair( x, true ) );
+	for( auto x : b ) 
+		all.push_back( std::make_pair( x, false ) );
+	std::sort( all.begin(), all.end() );
+	double rank_sum{0};
+	double ties{0};
+	for( std::size_t i{0}; i < all.size(); ) {
+		std::size_t j{i};
+		while( j < all.size() && all[j].first == all[i].first ) 
+			j++;
+		const double rank = ( i + 1 + j ) / 2.0;
+		const double t = j - i;
+		ties += t*t*t - t;
+		for( ; i < j; i++ ) 
+			if ( all[i].second )
+				rank_sum += rank;
+	}
+	const double n = n1 + n2;
+	const double u = rank_sum - n1 * (n1+1) / 2;
+	const double mean = n1 * n2 / 2;
+	const double variance = n1 * n2 / 12 * ( (n+1) - ties / (n * (n-1)) );
+	if ( variance <= 0 ) 
+		return u > mean ? 0.0 : 1.0;
+	
+	// normal approximation with continuity correction
+	const double z = ( u - mean - 0.5 ) / std::sqrt( variance );
+	return 0.5 * std::erfc( z / std::sqrt( 2.0 ) );
 }
 
-template <class...Args>
-std::string testbench::intern::concatenate( Args... args ) {
-	try {
-		std::stringstream ss;
-		return write_to_stream( ss, args... );
-	} 
-	catch( ... ) {
+inline bool testbench::intern::glob( 
+	const std::string& pattern, 
+	const std::string& s ) 
+{
+	// On a mismatch, the last '*' is retried with one more character.
+	std::size_t p{0};
+	std::size_t i{0};
+	std::size_t star{ std::string::npos };
+	std::size_t resume{0};
+	while ( i < s.size() ) {
+		if ( p < pattern.size() && ( pattern[p] == '?' || pattern[p] == s[i] ) ) {
+			p++;
+			i++;
+		}
+		else if ( p < pattern.size() && pattern[p] == '*' ) {
+			star = p++;
+			resume = i;
+		}
+		else if ( star != std::string::npos ) {
+			p = star + 1;
+			i = ++resume;
+		}
+		else
+			return false;
+	}
+	while ( p < pattern.size() && pattern[p] == '*' )
+		p++;
+	return p == pattern.size();
+}
 
+inline std::vector<std::size_t> testbench::intern::shard( 
+	const std::vector<double>& weights, 
+	std::size_t count, 
+	std::size_t index ) 
+{
+	std::vector<std::size_t> order( weights.size() );
+	for( std::size_t i{0}; i < order.size(); i++ )
+		order[i] = i;
+	std::stable_sort( order.begin(), order.end(), 
+		[&]( std::size_t a, std::size_t b ) {
+			return weights[a] > weights[b];
+		} );
+	std::vector<double> load( count, 0.0 );
+	std::vector<std::size_t> result;
+	for( auto i : order ) {
+		const std::size_t s = std::min_element( load.begin(), load.end() ) 
+			- load.begin();
+		load[s] += weights[i];
+		if ( s == index )
+			result.push_back( i );
+	}
+	std::sort( result.begin(), result.end() );
+	return result;
+}
+
+inline std::map<std::string,testbench::outcome> 
+testbench::intern::load_history( 
+	const std::string& path ) 
+{
+	std::map<std::string,outcome> history;
+	std::ifstream file( path.c_str() );
+	long long ns;
+	std::string result;
+	while( file >> ns >> result ) {
+		std::string name;
+		file.get();
+		std::getline( file, name );
+		if ( !file )
+			break;
+		history[name] = outcome{ ns, result == "failed" };
+	}
+	return history;
+}
+
+inline void testbench::intern::save_history( 
+	const std::string& path, 
+	const std::map<std::string,outcome>& history ) 
+{
+	const std::string temporary( path + ".tmp" );
+	{
+		std::ofstream file( temporary.c_str() );
+		if ( !file )
+			throw std::runtime_error( "Cannot write " + temporary );
+
+		// <nanoseconds> <passed|failed> <name until end of line>
+		for( auto& h : history ) {
+			std::string name( h.first );
+			std::replace( name.begin(), name.end(), '\n', ' ' );
+			file << h.second.duration << ' ' 
+				<< ( h.second.failed ? "failed" : "passed" ) << ' '
+				<< name << '\n';
+		}
+		if ( !file.flush() )
+			throw std::runtime_error( "Cannot write " + temporary );
+	}
+	if ( std::rename( temporary.c_str(), path.c_str() ) ) {
+		std::remove( temporary.c_str() );
+		throw std::runtime_error( "Cannot replace " + path );
 	}
-	return std::string("[Creating feedback message failed due to an"
-		"exception]");
 }
 
 //
 // free functions
 //
-std::ostream& operator<<( std::ostream& os, const testbench& tb ) {
+inline std::ostream& operator<<( std::ostream& os, const testbench& tb ) {
 	static const std::string Indent("           ");
 	static const std::string Failed("[FAILED]   ");
 	static const std::string Passed("[OK]       ");
 	static const std::string Warning("[WARNING]  ");
-	bool failed{false};
+	static const std::string Skipped("[SKIPPED]  ");
+	static const std::string Bench("[BENCH]    ");
 	os << tb.name() << '\n';
 	for( auto i{ tb.name().size() }; i > 0; i-- )
 		os << '-';
 	os << '\n';
+	// Without counts, passing testcases don't seem to check anything.
+	const bool counted{ ELRAT_TESTBENCH_CHECKS != ELRAT_TESTBENCH_CHECKS_NONE };
 	auto& logs{ tb.logs() };
 	for ( auto& l : logs ) {
-		if ( l.entries.size() ) {
+		if ( l.failed_count ) {
 			os << Failed;
-			failed = true;
 		}
-		else if (!l.check_count)
+		else if ( l.aborted ) 
+			os << Skipped;
+		else if ( counted && !l.check_count )
 			os << Warning;
 		else
 			os << Passed;
@@ -569,8 +4502,16 @@ std::ostream& operator<<( std::ostream& os, const testbench& tb ) {
 			<< l.name 
 			<< "\" (checks: " 
 			<< l.check_count 
-			<< ')';
-		if ( !l.check_count ) 
+			<< ", "
+			<< testbench::intern::duration( l.used.wall_time );
+		if ( testbench::allocations::tracked() ) 
+			os << ", allocations: " 
+				<< l.used.allocations 
+				<< " / " 
+				<< l.used.allocated_bytes 
+				<< " bytes";
+		os << ')';
+		if ( counted && !l.check_count && !l.aborted ) 
 			os << " Empty testcase!";
 		os << '\n';
 		for( auto& e : l.entries ) {
@@ -578,34 +4519,202 @@ std::ostream& operator<<( std::ostream& os, const testbench& tb ) {
 				<< "#" 
 				<< e.position 
 				<< ": " 
-				<< e.message 
+				<< e.message() 
 				<< '\n';
 		}
+		if ( l.failed_count > static_cast<int>(l.entries.size()) ) 
+			os << Indent 
+				<< "(" 
+				<< l.failed_count - l.entries.size()
+				<< " more failed checks not recorded)\n";
+		if ( l.failed_count && l.aborted )
+			os << Indent 
+				<< "Aborted after " 
+				<< l.failed_count 
+				<< " failed checks.\n";
+	}
+	auto fixtures = tb.fixtures();
+	if ( fixtures.size() ) {
+		os << "\nFixtures\n--------\n";
+		for( auto& f : fixtures ) {
+			os << Indent 
+				<< '\"' 
+				<< f.first 
+				<< "\" (setup: " 
+				<< testbench::intern::duration( f.second )
+				<< ")\n";
+		}
+	}
+	auto slowest = tb.slowest();
+	if ( slowest.size() ) {
+		os << "\nSlowest testcases\n-----------------\n";
+		for( auto& x : slowest ) {
+			os << Indent 
+				<< '\"' 
+				<< x.first 
+				<< "\" (wall: " 
+				<< testbench::intern::duration( x.second.wall_time )
+				<< ", cpu: "
+				<< testbench::intern::duration( x.second.cpu_time )
+				<< ")\n";
+		}
+	}
+	const auto benchmarks = tb.benchmarks();
+	if ( benchmarks.size() ) {
+		os << "\nBenchmarks\n----------\n";
+		auto flags = os.flags();
+		auto precision = os.precision();
+		os << std::fixed << std::setprecision(2);
+		for( auto& b : benchmarks ) {
+			os << Bench 
+				<< '\"' 
+				<< b.name 
+				<< "\" (" 
+				<< b.samples.size() 
+				<< " x " 
+				<< b.iterations 
+				<< " iterations)\n"
+				<< Indent 
+				<< "mean " << b.mean 
+				<< ", median " << b.median 
+				<< ", stddev " << b.stddev 
+				<< ", min " << b.min 
+				<< ", max " << b.max 
+				<< " [ns/op]\n";
+		}
+		os.flags( flags );
+		os.precision( precision );
 	}
 	os << '\n';
-	if ( !tb.logs().size() )
+	auto totals = tb.totals();
+	if ( !totals.testcases )
 		os << "Nothing's been tested.\n";
 	else {
-		if ( !failed ) 
+		if ( !totals.failed_testcases ) 
 			os << "PASSED\n------\n(total: "
-				<< tb.testcases() 
+				<< totals.testcases 
 				<< " testcases, "
-				<< tb.checks() 
+				<< totals.checks 
 				<< " checks)\n";
 		else {
 			os << "FAILED\n------\n" 
-				<< tb.failed_testcases() 
+				<< totals.failed_testcases 
 				<< "/" 
-				<< tb.testcases() 
+				<< totals.testcases 
 				<< " testcases\n" 
-				<< tb.failed_checks() 
-				<< "/" << tb.checks() 
+				<< totals.failed_checks 
+				<< "/" << totals.checks 
 				<< " checks\n";
 		}
+		if ( tb.dropped_messages() ) 
+			os << "(" 
+				<< tb.dropped_messages() 
+				<< " messages of failed checks dropped)\n";
 	}
 	return os;
 }
 
 } // namespace elrat 
 
+//--- ALLOCATION TRACKING -----------------------------------------------------
+
+#ifdef ELRAT_TESTBENCH_TRACK_ALLOCATIONS
+
+namespace {
+	struct elrat_testbench_tracking {
+		elrat_testbench_tracking() {
+			elrat::testbench::allocations::tracked() = true;
+		}
+	} elrat_testbench_tracking_instance;
+}
+
+// The replacements allocate with malloc and release with free. Once they're
+// inlined, GCC sees free called on the result of operator new and warns, 
+// although the pair matches.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new( std::size_t size ) {
+	for( ;; ) {
+		void* p = std::malloc( size ? size : 1 );
+		if ( p ) {
+			elrat::testbench::allocations& a = 
+				elrat::testbench::allocations::current();
+			a.count++;
+			a.bytes += size;
+			return p;
+		}
+		std::new_handler handler = std::get_new_handler();
+		if ( !handler )
+			throw std::bad_alloc();
+		handler();
+	}
+}
+
+void* operator new[]( std::size_t size ) {
+	return ::operator new( size );
+}
+
+void* operator new( std::size_t size, const std::nothrow_t& ) noexcept {
+	try {
+		return ::operator new( size );
+	}
+	catch( ... ) {
+	}
+	return nullptr;
+}
+
+void* operator new[]( std::size_t size, const std::nothrow_t& ) noexcept {
+	return ::operator new( size, std::nothrow );
+}
+
+void operator delete( void* p ) noexcept {
+	std::free( p );
+}
+
+void operator delete[]( void* p ) noexcept {
+	std::free( p );
+}
+
+void operator delete( void* p, const std::nothrow_t& ) noexcept {
+	std::free( p );
+}
+
+void operator delete[]( void* p, const std::nothrow_t& ) noexcept {
+	std::free( p );
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete( void* p, std::size_t ) noexcept {
+	std::free( p );
+}
+
+void operator delete[]( void* p, std::size_t ) noexcept {
+	std::free( p );
+}
+#endif
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+#endif // ELRAT_TESTBENCH_TRACK_ALLOCATIONS
+
+//--- MAIN --------------------------------------------------------------------
+
+#ifdef ELRAT_TESTBENCH_MAIN
+
+// Runs the registered testcases, named after the program.
+int main( int argc, char* argv[] ) {
+	std::string name( argc > 0 ? argv[0] : "testbench" );
+	name.erase( 0, name.find_last_of( "/\\" ) + 1 );
+	elrat::testbench tb( name );
+	tb.define_registered();
+	return tb.main( argc, argv );
+}
+
+#endif // ELRAT_TESTBENCH_MAIN
+
 #endif // include guar
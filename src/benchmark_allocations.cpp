@@ -0,0 +1,106 @@
+//
+// project........: testbench
+//
+// file...........: src/benchmark_allocations.cpp
+//
+// author.........: elratmacfat
+//
+// description....: counts the heap allocations per check. Passing checks
+//                  must not allocate at all, so that checks within 
+//                  benchmarked code don't skew the measurements.
+//
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#define ELRAT_TESTBENCH_TRACK_ALLOCATIONS
+#include "elrat/testbench.h"
+
+using elrat::testbench;
+
+int main()
+{
+	testbench tb("Allocations per check");
+	testbench testee("testee testbench");
+	const int n{ 1000 };
+	const std::vector<float> a( 64, 1.0f );
+	const std::vector<float> b( 64, 2.0f );
+
+	// Calls the check n times, once passing and once failing, and counts
+	// the allocations.
+	auto count = [&]( 
+		const char* name, 
+		void (*check)( testbench::testcase&, const std::vector<float>&, 
+			const std::vector<float>&, bool ) ) 
+	{
+		auto y = testee.create( name );
+		double per_check[2];
+		for( int failing{0}; failing < 2; failing++ ) {
+			const long long before = testbench::allocations::current().count;
+			for( int i{0}; i < n; i++ )
+				check( y, a, b, failing != 0 );
+			per_check[failing] = double( 
+				testbench::allocations::current().count - before ) / n;
+		}
+		std::cout << std::left << std::setw(24) << name 
+			<< std::right << std::fixed << std::setprecision(2)
+			<< std::setw(8) << per_check[0] 
+			<< std::setw(8) << per_check[1] << '\n';
+		auto t = tb.create( name );
+		t.equal( per_check[0], 0.0 );
+	};
+	typedef const std::vector<float>& V;
+
+	std::cout << std::left << std::setw(24) << "check" 
+		<< std::right << std::setw(8) << "pass" << std::setw(8) << "fail" 
+		<< '\n';
+	count( "check", []( testbench::testcase& y, V, V, bool f ) { 
+		y.check( !f ); 
+	} );
+	count( "equal", []( testbench::testcase& y, V, V, bool f ) { 
+		y.equal( 1, f ? 2 : 1 ); 
+	} );
+	count( "equal (threshold)", []( testbench::testcase& y, V, V, bool f ) { 
+		y.equal( 1.0, f ? 2.0 : 1.0, 0.1 ); 
+	} );
+	count( "less_than", []( testbench::testcase& y, V, V, bool f ) { 
+		y.less_than( f ? 2 : 1, 2 ); 
+	} );
+	count( "in_range", []( testbench::testcase& y, V, V, bool f ) { 
+		y.in_range( f ? 5 : 1, 0, 2 ); 
+	} );
+	count( "near_ulps", []( testbench::testcase& y, V, V, bool f ) { 
+		y.near_ulps( 1.0, f ? 2.0 : 1.0, 4 ); 
+	} );
+	count( "near", []( testbench::testcase& y, V, V, bool f ) { 
+		y.near( 1.0, f ? 2.0 : 1.0, 1e-9, 1e-9 ); 
+	} );
+	count( "does_not_throw", []( testbench::testcase& y, V, V, bool f ) { 
+		y.does_not_throw( [f]() { 
+			if ( f ) 
+				throw std::runtime_error("error"); 
+		} ); 
+	} );
+	count( "throws_any", []( testbench::testcase& y, V, V, bool f ) { 
+		y.throws_any( [f]() { 
+			if ( !f ) 
+				throw 0; 
+		} ); 
+	} );
+	count( "throws", []( testbench::testcase& y, V, V, bool f ) { 
+		y.throws<int>( [f]() { 
+			if ( !f ) 
+				throw 0; 
+		} ); 
+	} );
+	count( "equal_range", []( testbench::testcase& y, V a, V b, bool f ) { 
+		y.equal_range( a.begin(), a.end(), f ? b.begin() : a.begin() ); 
+	} );
+	count( "all_near", []( testbench::testcase& y, V a, V b, bool f ) { 
+		y.all_near( a, f ? b : a, 0.5f ); 
+	} );
+	std::cout << '\n' << tb << '\n';
+	return tb.failed_testcases() ? 1 : 0;
+}
@@ -0,0 +1,118 @@
+//
+// project........: testbench
+//
+// file...........: src/benchmark_checks.cpp
+//
+// author.........: elratmacfat
+//
+// description....: measures the time per passing check, compared to the
+//                  bare comparison. It's built once for each mode of
+//                  ELRAT_TESTBENCH_CHECKS (see CMakeLists.txt), and checks
+//                  what that mode records. Meaningful times require an
+//                  optimized build.
+//
+#include <iostream>
+#include <vector>
+
+#include "elrat/testbench.h"
+
+using elrat::testbench;
+
+int main()
+{
+#if ELRAT_TESTBENCH_CHECKS == ELRAT_TESTBENCH_CHECKS_FULL
+	testbench tb("Time per check (full diagnostics)");
+#elif ELRAT_TESTBENCH_CHECKS == ELRAT_TESTBENCH_CHECKS_COUNT
+	testbench tb("Time per check (count only)");
+#else
+	testbench tb("Time per check (none)");
+#endif
+	testbench testee("testee testbench");
+
+	// The operands are read from memory, so the comparisons can't be
+	// folded away.
+	volatile int one{1};
+	volatile double x{1.0};
+	const std::vector<float> a( 64, 1.0f );
+
+	tb.measure( "bare comparison", [&]() {
+		testbench::do_not_optimize( one == 1 );
+	} );
+	{
+		auto y = testee.create( "check" );
+		tb.measure( "check", [&]() {
+			y.check( one == 1 );
+		} );
+	}
+	{
+		auto y = testee.create( "equal" );
+		tb.measure( "equal", [&]() {
+			y.equal( int( one ), 1 );
+		} );
+	}
+	{
+		auto y = testee.create( "less_than" );
+		tb.measure( "less_than", [&]() {
+			y.less_than( double( x ), 2.0 );
+		} );
+	}
+	{
+		auto y = testee.create( "near" );
+		tb.measure( "near", [&]() {
+			y.near( double( x ), 1.0, 1e-9, 1e-9 );
+		} );
+	}
+	{
+		auto y = testee.create( "equal_range (64 elements)" );
+		tb.measure( "equal_range (64 elements)", [&]() {
+			y.equal_range( a.begin(), a.end(), a.begin() );
+		} );
+	}
+
+	// What a passing and a failing check record in this mode.
+	{
+		auto y = testee.create( "recorded" );
+		y.equal( int( one ), 1 );
+		y.equal( int( one ), 2 );
+	}
+	{
+		auto t = tb.create( "recorded by the checks" );
+		auto& l = testee.logs().back();
+		t.equal( l.failed_count, 1 );
+#if ELRAT_TESTBENCH_CHECKS == ELRAT_TESTBENCH_CHECKS_FULL
+		t.equal( l.check_count, 2 );
+		t.equal( l.entries.size(), std::size_t{1} );
+		t.equal( l.entries.at(0).message(),
+			std::string( "Expected [2], but found [1]." ) );
+#elif ELRAT_TESTBENCH_CHECKS == ELRAT_TESTBENCH_CHECKS_COUNT
+		t.equal( l.check_count, 2 );
+		t.check( l.entries.empty() );
+#else
+		t.equal( l.check_count, 1 );
+		t.equal( l.entries.size(), std::size_t{1} );
+		t.equal( l.entries.at(0).message(),
+			std::string( "Expected [2], but found [1]." ) );
+#endif
+	}
+
+	// Checks of an aborted testcase are not counted (see 
+	// 'policy::max_failed_checks').
+	{
+		testbench::policy p;
+		p.max_failed_checks = 1;
+		testee.configure( p );
+		{
+			auto y = testee.create( "aborted" );
+			y.equal( int( one ), 2 );
+			for( int i{0}; i < 5; i++ ) 
+				y.equal( int( one ), 1 );
+		}
+		auto t = tb.create( "checks skipped after abort" );
+		auto& l = testee.logs().back();
+		t.check( l.aborted );
+		t.equal( l.failed_count, 1 );
+		t.equal( l.check_count, 1 );
+	}
+	std::cout << tb << '\n';
+	return tb.failed_testcases() ? 1 : 0;
+}
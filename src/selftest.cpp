@@ -15,6 +15,13 @@
 //                  testbench.....:     tb       x
 //                  testcase......:     t        y,z
 //                  
+#include <csignal>
+#include <fstream>
+#include <thread>
+
+// Replaces operator new and delete to count allocations, which is required
+// by 'allocates_at_most'.
+#define ELRAT_TESTBENCH_TRACK_ALLOCATIONS
 #include "elrat/testbench.h"
 
 // Operator overloads that throw exceptions, simulating all kind of faulty 
@@ -31,6 +38,19 @@ bool operator>=(const A&, const A&);
 bool operator<(const A&, const A&);
 bool operator>(const A&, const A&);
 
+// Counts how often it's been written to an output stream, to verify that
+// feedback messages are only created for failed checks.
+struct B {
+	int value = 0;
+	static int written;
+};
+
+int B::written = 0;
+
+std::ostream& operator<<(std::ostream&, const B&);
+bool operator==(const B&, const B&);
+bool operator<(const B&, const B&);
+
 int main() {
 	
 	using elrat::testbench;
@@ -218,6 +238,1064 @@ int main() {
 		}); 
 	}
 
+	//
+	{
+		auto t = tb.create("feedback message created on failure only");
+		testbench x("testee testbench");
+		{
+			auto y = x.create("testee testcase");
+			B b1, b2;
+			b2.value = 1;
+			y.equal( b1, b1 );
+			y.less_than( b1, b2 );
+			t.equal( B::written, 0 );
+			y.equal( b1, b2 );
+			t.equal( B::written, 2 );
+		}
+		t.equal( x.failed_checks(), 1 );
+	}
+
+	//
+	{
+		auto t = tb.create("define and run on multiple threads");
+		testbench x("testee testbench");
+		for( int i = 0; i < 100; i++ ) {
+			x.define( std::to_string(i), [i]( testbench::testcase& y ) {
+				y.check( i % 10 != 0 );
+				if ( i % 25 == 0 )
+					throw std::runtime_error("unhandled");
+			});
+		}
+		x.run( 4 );
+		t.equal( x.testcases(), 100 );
+		t.equal( x.failed_testcases(), 12 );
+		t.equal( x.failed_checks(), 14 );
+		bool ordered = true;
+		for( int i = 0; i < x.testcases(); i++ ) 
+			ordered = ordered && x.logs()[i].name == std::to_string(i);
+		t.check( ordered );
+
+		// Nothing left to run.
+		x.run( 4 );
+		t.equal( x.testcases(), 100 );
+	}
+
+	//
+	{
+		auto t = tb.create("testcases reporting from multiple threads");
+		testbench x("testee testbench");
+		std::vector<std::thread> threads;
+		for( int i = 0; i < 8; i++ ) {
+			threads.push_back( std::thread( [&x](){
+				for( int j = 0; j < 100; j++ ) {
+					auto y = x.create("testee testcase");
+					y.check( j % 2 );
+				}
+			}));
+		}
+		for( auto& thread : threads )
+			thread.join();
+		t.equal( x.testcases(), 800 );
+		t.equal( x.failed_testcases(), 400 );
+		auto totals = x.totals();
+		t.equal( totals.testcases, 800 );
+		t.equal( totals.checks, 800 );
+		t.equal( totals.failed_testcases, 400 );
+		t.equal( totals.failed_checks, 400 );
+	}
+
+	//
+	{
+		auto t = tb.create("policy: limits of failed checks and testcases");
+		testbench x("testee testbench");
+		testbench::policy p;
+		p.max_failed_checks = 5;
+		p.max_failed_testcases = 2;
+		p.max_entries = 3;
+		x.configure( p );
+		{
+			auto y = x.create("testee testcase");
+			for( int i = 0; i < 1000 && !y.aborted(); i++ )
+				y.equal( i, -1 );
+			t.check( y.aborted() );
+			y.check( false ); // skipped
+		}
+		t.equal( x.failed_checks(), 5 );
+		t.equal( x.checks(), 5 );
+		t.equal( static_cast<int>(x.logs()[0].entries.size()), 3 );
+		t.check( !x.aborted() );
+		{
+			auto y = x.create("testee testcase");
+			y.check( false );
+		}
+		t.check( x.aborted() );
+		for( int i = 0; i < 10; i++ ) 
+			x.define( "skipped", []( testbench::testcase& y ) {
+				y.check( false );
+			});
+		x.run( 2 );
+		t.equal( x.testcases(), 12 );
+		t.equal( x.failed_testcases(), 2 );
+		t.equal( x.failed_checks(), 6 );
+	}
+
+	//
+	{
+		auto t = tb.create("policy: memory limit of failure messages");
+		testbench x("testee testbench");
+		testbench y("testee testbench");
+		testbench::policy p;
+		p.max_message_bytes = 1000;
+		x.configure( p );
+		p.drop_oldest_messages = true;
+		y.configure( p );
+		{
+			auto z1 = x.create("dropping newest");
+			auto z2 = y.create("dropping oldest");
+			for( int i = 0; i < 1000; i++ ) {
+				z1.equal( i, -1 );
+				z2.equal( i, -1 );
+			}
+		}
+		t.equal( x.failed_checks(), 1000 );
+		t.equal( y.failed_checks(), 1000 );
+		t.less_than( static_cast<int>(x.logs()[0].entries.size()), 100 );
+		t.greater_than( static_cast<int>(x.dropped_messages()), 900 );
+		t.equal( x.logs()[0].entries[0].message(), 
+			std::string("Expected [-1], but found [0].") );
+		t.equal( static_cast<int>(y.logs()[0].entries.size()), 1000 );
+		t.greater_than( static_cast<int>(y.dropped_messages()), 900 );
+		t.equal( y.logs()[0].entries[0].message(), 
+			std::string("[message dropped]") );
+		t.equal( y.logs()[0].entries[999].message(), 
+			std::string("Expected [-1], but found [999].") );
+	}
+
+	//
+	{
+		auto t = tb.create("measure");
+		testbench x("testee testbench");
+		testbench::policy p;
+		p.samples = 5;
+		p.sample_time = std::chrono::microseconds(100);
+		x.configure( p );
+		int calls{0};
+		auto b = x.measure( "increment", [&calls](){
+			calls++;
+			testbench::do_not_optimize( calls );
+		});
+		t.equal( b.name, std::string("increment") );
+		t.equal( static_cast<int>(b.samples.size()), 5 );
+		t.greater_than( b.iterations, 0ll );
+		t.check( b.min <= b.median && b.median <= b.max );
+		t.check( b.min <= b.mean && b.mean <= b.max );
+		t.greater_than_or_equal( b.stddev, 0.0 );
+		t.equal( static_cast<int>(x.benchmarks().size()), 1 );
+
+		// later benchmarks leave the earlier ones intact
+		for( int i{0}; i < 10; i++ ) 
+			x.measure( "empty", [](){} );
+		auto all = x.benchmarks();
+		t.equal( static_cast<int>(all.size()), 11 );
+		t.equal( all.at(0).name, std::string("increment") );
+		t.equal( all.at(0).median, b.median );
+	}
+
+	//
+	{
+		auto t = tb.create("completes_within");
+		t.completes_within( std::chrono::seconds(10), [](){} );
+		testbench x("testee testbench");
+		{
+			auto y = x.create("testee testcase");
+			y.completes_within( std::chrono::microseconds(100), [](){
+				std::this_thread::sleep_for( 
+					std::chrono::milliseconds(2) );
+			});
+			y.completes_within( std::chrono::seconds(10), [](){
+				throw 42;
+			});
+		}
+		t.equal( x.failed_checks(), 2 );
+	}
+	//
+	{
+		auto t = tb.create("allocates_at_most");
+		t.allocates_at_most( 0, [](){} );
+		t.allocates_at_most( 1000, [](){ 
+			std::vector<char> v( 1000 ); 
+		});
+		testbench x("testee testbench");
+		{
+			auto y = x.create("testee testcase");
+			y.allocates_at_most( 999, [](){
+				std::vector<char> v( 1000 ); 
+			});
+		}
+		t.equal( x.failed_checks(), 1 );
+	}
+
+	// The replaced operator new calls the new-handler, until it's removed.
+	{
+		auto t = tb.create("new-handler of the replaced operator new");
+		struct handler {
+			static int& calls() {
+				static int c{0};
+				return c;
+			}
+			static void call() {
+				calls()++;
+				std::set_new_handler( nullptr );
+			}
+		};
+		volatile std::size_t size{ std::numeric_limits<std::size_t>::max() / 2 };
+		const std::new_handler previous = std::set_new_handler( handler::call );
+		t.throws<std::bad_alloc>( [&]() {
+			::operator delete( ::operator new( size ) );
+		} );
+		std::set_new_handler( previous );
+		t.equal( handler::calls(), 1 );
+	}
+
+	//
+	{
+		auto t = tb.create("save_baseline and compare_baseline");
+		testbench x("testee testbench");
+		testbench::policy p;
+		p.samples = 10;
+		p.sample_time = std::chrono::microseconds(200);
+		x.configure( p );
+		int calls{0};
+		x.measure( "increment", [&calls](){
+			calls++;
+			testbench::do_not_optimize( calls );
+		});
+		x.measure( "no baseline", [](){} );
+		const std::string path("selftest.baseline");
+		t.does_not_throw( [&](){
+			x.save_baseline( path );
+		});
+		t.equal( x.compare_baseline( path ), 2 );
+		
+		// a baseline, that's faster by orders of magnitude
+		{
+			std::ofstream file( path.c_str() );
+			file << "5 1e-6 2e-6 1e-6 3e-6 1e-6 increment\n";
+		}
+		t.equal( x.compare_baseline( path ), 1 );
+		t.equal( x.testcases(), 3 );
+		t.equal( x.failed_testcases(), 1 );
+		t.equal( x.logs()[2].name, std::string("Baseline: increment") );
+		t.equal( x.logs()[2].failed_count, 1 );
+
+		// corrupt baselines, e.g. with an absurd number of samples
+		for( auto content : { "99999999999999999 1 2 increment\n", 
+			"-1 1 increment\n", "0 increment\n", "3 1 x increment\n" } ) 
+		{
+			{
+				std::ofstream file( path.c_str() );
+				file << content;
+			}
+			t.equal( x.compare_baseline( path ), 0 );
+		}
+		std::remove( path.c_str() );
+		t.equal( x.compare_baseline( path ), 0 );
+	}
+
+	//
+	{
+		auto t = tb.create("reporters without retaining logs");
+		testbench x("testee \"testbench\"");
+		testbench::policy p;
+		p.retain_logs = false;
+		x.configure( p );
+		std::stringstream json, xml;
+		testbench::json_lines_reporter r1( json );
+		testbench::junit_reporter r2( xml );
+		x.attach( r1 );
+		x.attach( r2 );
+		{
+			auto y = x.create("<passed>");
+			y.check( true );
+		}
+		{
+			auto y = x.create("failed");
+			y.check( true );
+			y.equal( 1, 2 );
+		}
+		x.finish();
+		t.equal( x.testcases(), 2 );
+		t.equal( x.failed_checks(), 1 );
+		t.equal( static_cast<int>(x.logs().size()), 0 );
+
+		std::vector<std::string> lines;
+		for( std::string line; std::getline( json, line ); ) 
+			lines.push_back( line );
+		t.equal( static_cast<int>(lines.size()), 3 );
+		t.equal( lines[1], std::string(
+			"{\"testbench\":\"testee \\\"testbench\\\"\","
+			"\"testcase\":\"failed\",\"checks\":2,"
+			"\"failed_checks\":1,\"aborted\":false,"
+			"\"failures\":[{\"check\":2,"
+			"\"message\":\"Expected [2], but found [1].\"}]}") );
+		t.equal( lines[2], std::string(
+			"{\"testbench\":\"testee \\\"testbench\\\"\","
+			"\"testcases\":2,\"checks\":3,"
+			"\"failed_testcases\":1,\"failed_checks\":1}") );
+
+		const std::string junit( xml.str() );
+		t.check( junit.find("name=\"&lt;passed&gt;\"/>") 
+			!= std::string::npos );
+		t.check( junit.find("<failure message=\"1 of 2 checks failed\">"
+			"#2: Expected [2], but found [1].\n</failure>") 
+			!= std::string::npos );
+		t.check( junit.find("</testsuite>") != std::string::npos );
+	}
+
+	// Crashing testcases can only be tested with worker processes.
+#ifdef ELRAT_TESTBENCH_FORK
+	{
+		auto t = tb.create("run_isolated");
+		testbench x("testee testbench");
+		testbench::policy p;
+		p.testcase_timeout = std::chrono::milliseconds(200);
+		x.configure( p );
+		x.define( "passing", []( testbench::testcase& y ) {
+			y.check( true );
+		});
+		x.define( "crashing", []( testbench::testcase& y ) {
+			y.check( true );
+			std::raise( SIGSEGV );
+		});
+		x.define( "failing", []( testbench::testcase& y ) {
+			y.check( true );
+			y.equal( 1, 2 );
+		});
+		x.define( "hanging", []( testbench::testcase& ) {
+			std::this_thread::sleep_for( std::chrono::seconds(10) );
+		});
+		for( int i = 0; i < 20; i++ )
+			x.define( "many", []( testbench::testcase& y ) {
+				y.check( true );
+			});
+		x.run_isolated( 3 );
+		t.equal( x.testcases(), 24 );
+		t.equal( x.failed_testcases(), 3 );
+		t.equal( x.checks(), 25 );
+		auto& logs = x.logs();
+		t.equal( logs[0].name, std::string("passing") );
+		t.equal( logs[0].failed_count, 0 );
+		t.equal( logs[1].name, std::string("crashing") );
+		t.equal( logs[1].failed_count, 1 );
+		t.equal( logs[1].entries[0].message().find(
+			"Worker process "), std::size_t(0) );
+		t.equal( logs[2].entries[0].message(), 
+			std::string("Expected [2], but found [1].") );
+		t.equal( logs[3].entries[0].message(), 
+			std::string("Timed out after 200.00 ms.") );
+	}
+	{
+		auto t = tb.create("global_timeout of run_isolated");
+		testbench x("testee testbench");
+		testbench::policy p;
+		p.global_timeout = std::chrono::milliseconds(300);
+		x.configure( p );
+		for( int i = 0; i < 3; i++ )
+			x.define( "hanging", []( testbench::testcase& ) {
+				std::this_thread::sleep_for( std::chrono::seconds(10) );
+			});
+		const auto start = std::chrono::steady_clock::now();
+		x.run_isolated( 1 );
+		t.less_than( static_cast<long long>( 
+			std::chrono::duration_cast<std::chrono::milliseconds>( 
+				std::chrono::steady_clock::now() - start ).count() ), 5000ll );
+		t.equal( x.failed_testcases(), 3 );
+		t.equal( x.logs()[2].entries[0].message(), 
+			std::string("Global timeout of 300.00 ms exceeded.") );
+	}
+	{
+		// The watchdog terminates the process, so the testee runs in a 
+		// child process with its output redirected to a file.
+		auto t = tb.create("testcase_timeout in-process");
+		const std::string path("selftest_watchdog.txt");
+		std::cout.flush();
+		const pid_t pid = ::fork();
+		if ( !pid ) {
+			if ( !std::freopen( path.c_str(), "w", stdout ) )
+				std::_Exit( 2 );
+			testbench x("testee testbench");
+			testbench::policy p;
+			p.testcase_timeout = std::chrono::milliseconds(50);
+			x.configure( p );
+			x.define( "hanging", []( testbench::testcase& y ) {
+				y.check( true );
+				std::this_thread::sleep_for( std::chrono::seconds(10) );
+			});
+			x.define( "passing", []( testbench::testcase& y ) {
+				y.check( true );
+			});
+			x.run( 2 );
+			std::_Exit( 0 );
+		}
+		int status{0};
+		::waitpid( pid, &status, 0 );
+		t.check( WIFEXITED(status) );
+		t.equal( WEXITSTATUS(status), 1 );
+		std::ifstream file( path.c_str() );
+		const std::string out( ( std::istreambuf_iterator<char>( file ) ),
+			std::istreambuf_iterator<char>() );
+		t.check( out.find("[OK]       \"passing\"") != std::string::npos );
+		t.check( out.find("[FAILED]   \"hanging\"") != std::string::npos );
+		t.check( out.find("(timeout: 50.00 ms).") != std::string::npos );
+		std::remove( path.c_str() );
+	}
+#endif
+
+	//
+	{
+		auto t = tb.create("resources used by testcases");
+		testbench x("testee testbench");
+		testbench::policy p;
+		p.slowest_testcases = 2;
+		x.configure( p );
+		{
+			auto y = x.create("sleeping");
+			std::this_thread::sleep_for( std::chrono::milliseconds(5) );
+		}
+		{
+			auto y = x.create("allocating");
+			std::vector<char> v( 1000 );
+			testbench::do_not_optimize( v );
+		}
+		{
+			auto y = x.create("idle");
+		}
+		auto& logs = x.logs();
+		long long wall = logs[0].used.wall_time.count();
+		long long cpu = logs[0].used.cpu_time.count();
+		t.greater_than_or_equal( wall, 5000000ll );
+		t.less_than( cpu, wall );
+		t.equal( logs[1].used.allocations, 1ll );
+		t.equal( logs[1].used.allocated_bytes, 1000ll );
+		auto slowest = x.slowest();
+		t.equal( static_cast<int>(slowest.size()), 2 );
+		t.equal( slowest[0].first, std::string("sleeping") );
+	}
+
+	//
+	{
+		auto t = tb.create("equal_range, all_in_range, all_near");
+		std::vector<int> a( 100000, 7 );
+		std::vector<int> b( a );
+		std::vector<float> c( 100000, 1.0f );
+		std::vector<float> d( 100000, 1.0005f );
+		t.equal_range( a.begin(), a.end(), b.begin() );
+		t.equal_range( a.data(), a.data() + a.size(), b.data() );
+		t.all_in_range( a, 7, 8 );
+		t.all_in_range( a.begin(), a.end(), 6, 7 );
+		t.all_near( c, d, 0.001f );
+		t.all_near( a, b, 0 );
+
+		testbench x("testee testbench");
+		testbench::policy p;
+		p.max_mismatches = 2;
+		x.configure( p );
+		b[5] = 1;
+		b[70000] = 2;
+		b[99999] = 3;
+		c[10] = std::nanf("");
+		{
+			auto y = x.create("testee testcase");
+			y.equal_range( a.begin(), a.end(), b.begin() );
+			y.all_in_range( b, 2, 7 );
+			y.all_near( c, d, 0.001f );
+			y.all_near( d, d, 0.0f );
+			y.all_near( a, std::vector<int>( 10 ), 1 );
+		}
+		t.equal( x.checks(), 5 );
+		t.equal( x.failed_checks(), 4 );
+		auto& entries = x.logs()[0].entries;
+		t.equal( entries[0].message(), std::string(
+			"3 of 100000 elements differ. First at #5: expected [1], "
+			"but found [7]; #70000: expected [2], but found [7].") );
+		t.equal( entries[1].message(), std::string(
+			"1 of 100000 elements are not in [2, 7]. "
+			"First at #5: [1].") );
+		t.equal( entries[2].message(), std::string(
+			"1 of 100000 elements deviate by more than 0.001. "
+			"First at #10: expected [1.0005], but found [nan].") );
+		t.equal( entries[3].message(), std::string(
+			"Expected 10 elements, but found 100000.") );
+	}
+
+	//
+	{
+		auto t = tb.create("near_ulps, near_relative, near");
+		const double nan = std::nan("");
+		const double inf = HUGE_VAL;
+		t.near_ulps( 1.0, std::nextafter(1.0, 2.0), 1 );
+		t.near_ulps( 0.0, -0.0, 0 );
+		t.near_ulps( -std::nextafter(0.0f, 1.0f), 
+			std::nextafter(0.0f, 1.0f), 2 );
+		t.near_ulps( 1e300, std::nextafter(1e300, 0.0), 1 );
+		t.near_ulps( 0.1f + 0.2f, 0.3f, 1 );
+		t.near_ulps( inf, inf, 0 );
+		t.near_relative( 1e20, 1e20 + 1e8, 1e-10 );
+		t.near( 1e-20, 0.0, 1e-12, 1e-9 );
+		t.near( 1e20, 1e20 + 1e8, 1e-12, 1e-9 );
+		std::vector<float> a( 10000, 1.0f );
+		std::vector<float> b( 10000, std::nextafter(1.0f, 0.0f) );
+		t.all_near_ulps( a, b, 1 );
+		t.all_near_relative( a, b, 1e-6f );
+		t.all_near( a, b, 0.0f, 1e-6f );
+
+		testbench x("testee testbench");
+		{
+			auto y = x.create("testee testcase");
+			y.equal( nan, nan, 1.0 );
+			y.equal( 1.0, nan, 1.0 );
+			y.near_ulps( nan, nan, 
+				std::numeric_limits<std::uint64_t>::max() );
+			y.near_ulps( 1.0, 1.0 + 1e-15, 2 );
+			y.near_relative( 1.0, nan, 1.0 );
+			y.near_relative( 1.0, 1.1, 0.01 );
+			y.near( nan, 0.0, 1.0, 1.0 );
+			y.near( 1e-6, 0.0, 1e-9, 0.5 );
+			a[3] = std::nanf("");
+			y.all_near_ulps( a, b, 1 );
+			y.all_near_relative( a, b, 1e-6f );
+			y.all_near( a, b, 1e-6f, 0.0f );
+		}
+		t.equal( x.checks(), 11 );
+		t.equal( x.failed_checks(), 11 );
+		auto& entries = x.logs()[0].entries;
+		t.equal( entries[3].message(), std::string(
+			"Expected [1], but found [1]. Distance of 5 ulps "
+			"exceeds threshold=2") );
+		t.equal( entries[8].message(), std::string(
+			"1 of 10000 elements are more than 1 ulps apart. "
+			"First at #3: expected [1], but found [nan].") );
+	}
+
+	//
+	{
+		auto t = tb.create("for_all");
+		int cases{0};
+		t.for_all( 
+			testbench::integers<int>(), 
+			testbench::integers<int>(),
+			[&]( int a, int b ) {
+				cases++;
+				return std::max( a, b ) >= std::min( a, b );
+			} );
+		t.equal( cases, testbench::policy().property_cases );
+		t.for_all(
+			testbench::floats<double>( -1.0, 1.0 ),
+			testbench::integers<std::int8_t>( -10, -5 ),
+			testbench::integers<std::uint64_t>( 5, 10 ),
+			[]( double d, std::int8_t i, std::uint64_t u ) {
+				return d >= -1.0 && d <= 1.0 && i >= -10 && i <= -5 
+					&& u >= 5 && u <= 10;
+			} );
+		t.for_all(
+			testbench::strings( 4, "ab" ),
+			[]( const std::string& s ) {
+				return s.size() <= 4 && s.find('c') == std::string::npos;
+			} );
+
+		testbench x("testee testbench");
+		testbench::policy p;
+		p.property_cases = 10000;
+		x.configure( p );
+		{
+			auto y = x.create("testee testcase");
+			y.for_all( 
+				testbench::integers<int>(),
+				[]( int i ) { return i < 1000; } );
+			y.for_all( 
+				testbench::vectors_of( testbench::integers<int>( 0, 50 ) ),
+				[]( const std::vector<int>& v ) {
+					int sum{0};
+					for( auto i : v )
+						sum += i;
+					return sum < 100;
+				} );
+			y.for_all( 
+				testbench::strings(),
+				[]( const std::string& s ) { 
+					return s.find('x') == std::string::npos; 
+				} );
+			y.for_all( 
+				testbench::integers<long long>(),
+				testbench::floats<float>(),
+				[]( long long i, float ) {
+					if ( i < -10 ) 
+						throw std::runtime_error("negative");
+					return true;
+				} );
+		}
+		t.equal( x.failed_checks(), 4 );
+		auto& entries = x.logs()[0].entries;
+		auto counterexample = [&]( std::size_t i ) {
+			auto msg = entries[i].message();
+			return msg.substr( msg.find(": (") );
+		};
+		t.equal( counterexample(0), std::string(": (1000).") );
+		t.equal( counterexample(1), std::string(": ({50, 50}).") );
+		t.equal( counterexample(2), std::string(": (\"x\").") );
+		t.equal( counterexample(3), 
+			std::string(": (-11, 0), std::exception: [negative].") );
+
+		// The same seed creates the same cases, which reuse their memory.
+		testbench z("testee testbench");
+		z.configure( p );
+		auto allocations = [&]( int n ) {
+			p.property_cases = n;
+			z.configure( p );
+			auto a = testbench::allocations::current().count;
+			{
+				auto y = z.create("testee testcase");
+				y.for_all( 
+					testbench::vectors_of( testbench::integers<int>() ),
+					testbench::strings(),
+					[]( const std::vector<int>&, const std::string& ) { 
+						return true; 
+					} );
+			}
+			return testbench::allocations::current().count - a;
+		};
+		allocations( 10 );
+		t.equal( allocations( 1000 ), allocations( 100000 ) );
+		{
+			auto y = z.create("testee testcase");
+			y.for_all( 
+				testbench::integers<int>(),
+				[]( int i ) { return i < 1000; } );
+		}
+		t.equal( z.logs()[3].entries[0].message(), entries[0].message() );
+	}
+
+	//
+	{
+		auto t = tb.create("for_all with shards");
+		testbench x("testee testbench");
+		testbench::policy p;
+		p.property_cases = 100000;
+		p.property_shards = 4;
+		x.configure( p );
+		std::atomic<int> cases{0};
+		std::mutex lock;
+		std::vector<std::thread::id> threads;
+		{
+			auto y = x.create("testee testcase");
+			y.for_all( 
+				testbench::integers<int>(),
+				[&]( int ) { 
+					if ( cases++ % 1000 == 0 ) {
+						std::lock_guard<std::mutex> guard( lock );
+						threads.push_back( std::this_thread::get_id() );
+					}
+					return true;
+				} );
+			y.for_all( 
+				testbench::integers<int>(),
+				[]( int i ) { return i < 1000; } );
+		}
+		t.equal( cases.load(), p.property_cases );
+		std::sort( threads.begin(), threads.end() );
+		threads.erase( std::unique( threads.begin(), threads.end() ), 
+			threads.end() );
+		t.greater_than( threads.size(), std::size_t{1} );
+		t.equal( x.checks(), 2 );
+		t.equal( x.failed_checks(), 1 );
+		auto msg = x.logs()[0].entries[0].message();
+		t.equal( msg.substr( msg.find(": (") ), std::string(": (1000).") );
+
+		// The first counterexample cancels the other shards.
+		p.property_cases = 1000000;
+		p.property_shards = 0;
+		x.configure( p );
+		cases = 0;
+		{
+			auto y = x.create("testee testcase");
+			y.for_all( 
+				testbench::integers<int>(),
+				[&]( int i ) { 
+					cases++;
+					return i < 1000; 
+				} );
+		}
+		t.less_than( cases.load(), 1000 );
+	}
+
+	//
+	{
+		auto t = tb.create("main");
+		auto define = [&]( testbench& x ) {
+			for( auto name : { "alpha", "beta", "gamma", "delta", "epsilon" } ) 
+				x.define( name, []( testbench::testcase& y ) { 
+					y.check( true ); 
+				} );
+			x.define( "failing", []( testbench::testcase& y ) { 
+				y.check( false ); 
+			} );
+		};
+		auto main = [&]( std::vector<std::string> args, std::string& out ) {
+			testbench x("testee testbench");
+			define( x );
+			args.insert( args.begin(), "selftest" );
+			std::vector<char*> argv;
+			for( auto& a : args )
+				argv.push_back( &a[0] );
+			std::stringstream ss;
+			const int result = x.main( int( argv.size() ), argv.data(), ss );
+			out = ss.str();
+			return result;
+		};
+		std::string out;
+		t.equal( main( { "--list" }, out ), 0 );
+		t.equal( out, std::string(
+			"alpha\nbeta\ngamma\ndelta\nepsilon\nfailing\n") );
+		t.equal( main( { "--list", "--filter=*l*a" }, out ), 0 );
+		t.equal( out, std::string("alpha\ndelta\n") );
+		t.equal( main( { "--list", "--regex=^[a-d]", "--filter=*a" }, out ), 0 );
+		t.equal( out, std::string("alpha\nbeta\ndelta\n") );
+		t.equal( main( { "--filter=*a", "--threads=2" }, out ), 0 );
+		t.check( out.find("PASSED") != std::string::npos );
+		t.equal( main( { "--threads=0", "--isolate" }, out ), 1 );
+		t.equal( main( { "--shard-count=2", "--shard-index=2" }, out ), 2 );
+		t.equal( main( { "--regex=(" }, out ), 2 );
+		t.equal( main( { "--unknown" }, out ), 2 );
+
+		// The shards cover every testcase once, and the durations of a 
+		// run balance the next one.
+		std::string all;
+		for( int i{0}; i < 3; i++ ) {
+			main( { "--list", "--shard-count=3", 
+				"--shard-index=" + std::to_string(i) }, out );
+			t.equal( std::count( out.begin(), out.end(), '\n' ), 2l );
+			all += out;
+		}
+		t.equal( all.size(), std::string(
+			"alpha\nbeta\ngamma\ndelta\nepsilon\nfailing\n").size() );
+		const std::string path("selftest_history.txt");
+		std::remove( path.c_str() );
+		main( { "--history=" + path }, out );
+		t.check( !std::ifstream( path.c_str() ) );
+		main( { "--history=" + path, "--save-history=" + path }, out );
+		{
+			std::ifstream file( path.c_str() );
+			t.equal( std::count( std::istreambuf_iterator<char>( file ), 
+				std::istreambuf_iterator<char>(), '\n' ), 6l );
+		}
+		{
+			std::ofstream file( path.c_str() );
+			file << "1000 passed gamma\n1 passed alpha\n1 passed beta\n"
+				"1 passed delta\n1 passed epsilon\n";
+		}
+		main( { "--list", "--shard-count=2", "--shard-index=0", 
+			"--history=" + path }, out );
+		t.equal( out, std::string("gamma\n") );
+		main( { "--list", "--shard-count=2", "--shard-index=1", 
+			"--history=" + path }, out );
+		t.equal( out, std::string("alpha\nbeta\ndelta\nepsilon\nfailing\n") );
+		std::remove( path.c_str() );
+	}
+
+	//
+	{
+		auto t = tb.create("load_history and save_history");
+		const std::string path("selftest_history.txt");
+		std::remove( path.c_str() );
+		auto define = [&]( testbench& x, int fail ) {
+			for( int i{0}; i < 4; i++ ) {
+				x.define( std::to_string(i), [=]( testbench::testcase& y ) {
+					y.check( i != fail );
+				} );
+			}
+		};
+		auto order = []( const testbench& x ) {
+			std::string names;
+			for( auto& l : x.logs() )
+				names += l.name;
+			return names;
+		};
+		{
+			// Without history, the order of definition is kept. The 
+			// results are recorded.
+			testbench x("testee testbench");
+			x.record_history();
+			define( x, 1 );
+			x.run( 2 );
+			t.equal( order( x ), std::string("0123") );
+			x.save_history( path );
+			std::ifstream file( path.c_str() );
+			std::string content( ( std::istreambuf_iterator<char>( file ) ),
+				std::istreambuf_iterator<char>() );
+			t.equal( std::count( content.begin(), content.end(), '\n' ), 4l );
+			t.check( content.find( " failed 1\n" ) != std::string::npos );
+		}
+		{
+			// Failed testcases first, then the longest ones.
+			std::ofstream file( path.c_str() );
+			file << "5 passed 0\n20 passed 1\n10 failed 2\n15 passed 3\n";
+		}
+		{
+			testbench x("testee testbench");
+			x.load_history( path );
+			define( x, -1 );
+			x.run( 2 );
+			t.equal( order( x ), std::string("2130") );
+		}
+		{
+			testbench x("testee testbench");
+			x.load_history( path );
+			define( x, -1 );
+			x.run_isolated( 2 );
+			t.equal( order( x ), std::string("2130") );
+		}
+		{
+			testbench x("testee testbench");
+			x.load_history( "selftest_missing_history.txt" );
+			define( x, -1 );
+			x.run();
+			t.equal( order( x ), std::string("0123") );
+		}
+		{
+			// Without recording, the results aren't kept.
+			testbench x("testee testbench");
+			define( x, -1 );
+			x.run();
+			x.save_history( path );
+			std::ifstream file( path.c_str() );
+			t.check( file && file.peek() == std::ifstream::traits_type::eof() );
+		}
+		std::remove( path.c_str() );
+	}
+
+	//
+	{
+		auto t = tb.create("formatting of messages");
+		testbench x("testee testbench");
+		B b1, b2;
+		b1.value = 7;
+		b2.value = -8;
+		{
+			auto y = x.create("testee testcase");
+			y.equal( std::numeric_limits<long long>::min(), 0ll );
+			y.equal( std::numeric_limits<unsigned long long>::max(), 0ull );
+			y.equal( std::int8_t(-5), std::int8_t(65) );
+			y.equal( 'a', 'b' );
+			y.equal( true, false );
+			y.equal( 1.5e-7, 2.0 / 3 );
+			y.equal( 0.1f, -std::numeric_limits<float>::infinity() );
+			y.equal( std::string("abc"), std::string() );
+			y.equal( b1, b2 );
+			y.in_range( 100, -10, 99 );
+			y.equal( 1.0, 2.0, 0.5 );
+		}
+		auto& e = x.logs()[0].entries;
+		t.equal( e[0].message(), std::string(
+			"Expected [0], but found [-9223372036854775808].") );
+		t.equal( e[1].message(), std::string(
+			"Expected [0], but found [18446744073709551615].") );
+		t.equal( e[2].message(), std::string(
+			"Expected [A], but found [\xfb].") );
+		t.equal( e[3].message(), std::string(
+			"Expected [b], but found [a].") );
+		t.equal( e[4].message(), std::string(
+			"Expected [0], but found [1].") );
+		t.equal( e[5].message(), std::string(
+			"Expected [0.666667], but found [1.5e-07].") );
+		t.equal( e[6].message(), std::string(
+			"Expected [-inf], but found [0.1].") );
+		t.equal( e[7].message(), std::string(
+			"Expected [], but found [abc].") );
+		t.equal( e[8].message(), std::string(
+			"Expected [-8], but found [7].") );
+		t.equal( e[9].message(), std::string(
+			"Expected value in [-10, 99], but found [100].") );
+		t.equal( e[10].message(), std::string(
+			"Expected [2], but found [1]. Absolute deviation=1 "
+			"exceeds threshold=0.5") );
+	}
+
+	// Registered testcases (src/selftest_registered.cpp) are listed in the 
+	// order of their definition, and are run by name.
+	{
+		auto t = tb.create( "registration" );
+		std::string names;
+		for( auto r = testbench::registration::first(); r; r = r->next() ) 
+			names += std::string( r->name() ) + ';';
+		t.equal( names, std::string( 
+			"registered passing;registered failing;registered other;"
+			"registered pair (first);registered pair (second);" ) );
+
+		auto main = [&]( std::vector<std::string> args, std::string& out ) {
+			testbench x("testee testbench");
+			t.equal( x.define_registered(), std::size_t{5} );
+			args.insert( args.begin(), "selftest" );
+			std::vector<char*> argv;
+			for( auto& a : args )
+				argv.push_back( &a[0] );
+			std::stringstream ss;
+			const int result = x.main( int( argv.size() ), argv.data(), ss );
+			out = ss.str();
+			return result;
+		};
+		std::string out;
+		t.equal( main( { "--list", "--filter=registered o*" }, out ), 0 );
+		t.equal( out, std::string( "registered other\n" ) );
+		t.equal( main( { "--filter=registered passing" }, out ), 0 );
+		t.check( out.find( "(total: 1 testcases, 2 checks)" ) 
+			!= std::string::npos );
+		t.equal( main( {}, out ), 1 );
+		t.check( out.find( "1/5 testcases" ) != std::string::npos );
+	}
+
+	// Fixtures are set up once on first use, shared by concurrent 
+	// testcases, and torn down by the destructor of the testbench.
+	{
+		auto t = tb.create( "fixtures" );
+		struct dataset {
+			std::vector<int> values;
+			std::atomic<int>* teardowns;
+			dataset() : teardowns{nullptr} {}
+			dataset( dataset&& d ) 
+			: values( std::move(d.values) ), teardowns{d.teardowns} {
+				d.teardowns = nullptr;
+			}
+			~dataset() { 
+				if ( teardowns ) 
+					(*teardowns)++; 
+			}
+		};
+		std::atomic<int> setups{0};
+		std::atomic<int> teardowns{0};
+		std::atomic<int> attempts{0};
+		std::stringstream ss;
+		{
+			testbench x("testee testbench");
+			x.fixture( "dataset", [&]() {
+				setups++;
+				std::this_thread::sleep_for( 
+					std::chrono::milliseconds(10) );
+				dataset d;
+				d.values.assign( 1000, 42 );
+				d.teardowns = &teardowns;
+				return d;
+			} );
+			x.fixture( "unused", []() { return 1; } );
+			x.fixture( "flaky", [&]() { 
+				if ( !attempts++ )
+					throw std::runtime_error( "setup failed" );
+				return std::string( "ok" );
+			} );
+			t.throws<std::logic_error>( [&]() {
+				x.fixture( "unused", []() { return 2; } );
+			} );
+			std::atomic<const dataset*> address{nullptr};
+			for( int i{0}; i < 8; i++ ) 
+				x.define( "user", [&]( testbench::testcase& y ) {
+					auto& d = y.fixture<dataset>( "dataset" );
+					y.equal( d.values.size(), std::size_t{1000} );
+					const dataset* expected{nullptr};
+					if ( !address.compare_exchange_strong( expected, &d ) )
+						y.check( expected == &d );
+				} );
+			x.define( "flaky", [&]( testbench::testcase& y ) {
+				y.equal( y.fixture<std::string>( "flaky" ), 
+					std::string("ok") );
+			} );
+			x.define( "flaky again", [&]( testbench::testcase& y ) {
+				y.equal( y.fixture<std::string>( "flaky" ), 
+					std::string("ok") );
+			} );
+			x.define( "wrong type", [&]( testbench::testcase& y ) {
+				y.fixture<long>( "unused" );
+			} );
+			x.define( "unknown", [&]( testbench::testcase& y ) {
+				y.fixture<int>( "unknown" );
+			} );
+			x.run( 4 );
+			t.equal( setups.load(), 1 );
+			t.equal( attempts.load(), 2 );
+			t.equal( teardowns.load(), 0 );
+			t.equal( x.failed_testcases(), 3 );
+			t.equal( x.logs()[8].entries.at(0).message(), std::string( 
+				"Unhandled std::exception: [setup failed]" ) );
+			t.check( x.logs()[10].entries.at(0).message().find( 
+				"No fixture [unused]" ) != std::string::npos );
+			auto f = x.fixtures();
+			t.equal( f.size(), std::size_t{2} );
+			t.equal( f.at(0).first, std::string( "dataset" ) );
+			t.check( f.at(0).second >= std::chrono::milliseconds(10) );
+			ss << x;
+		}
+		t.equal( teardowns.load(), 1 );
+		t.check( ss.str().find( "Fixtures\n--------\n" 
+			"           \"dataset\" (setup: " ) != std::string::npos );
+	}
+
+	// Golden files are compared in chunks, and replaced in update mode.
+	{
+		auto t = tb.create( "matches_golden" );
+		const std::string path( "selftest_golden.bin" );
+		std::remove( path.c_str() );
+		std::string bytes( 200000, '\0' );
+		for( std::size_t i{0}; i < bytes.size(); i++ ) 
+			bytes[i] = static_cast<char>( i * 7 );
+		std::string changed( bytes );
+		changed[150000] = 'A';
+
+		testbench x("testee testbench");
+		testbench::policy p;
+		p.update_goldens = false;
+		x.configure( p );
+		x.create( "missing" ).matches_golden( path, bytes );
+		p.update_goldens = true;
+		x.configure( p );
+		x.create( "update" ).matches_golden( path, bytes );
+		p.update_goldens = false;
+		x.configure( p );
+		{
+			auto y = x.create( "equal" );
+			y.matches_golden( path, bytes );
+			y.matches_golden( path, bytes.data(), bytes.size() );
+		}
+		{
+			auto y = x.create( "different" );
+			y.matches_golden( path, changed );
+			y.matches_golden( path, std::vector<char>( 
+				bytes.begin(), bytes.begin() + 3 ) );
+		}
+		p.golden_directory = ".";
+		p.update_goldens = true;
+		x.configure( p );
+		x.create( "update empty" ).matches_golden( path, std::string() );
+		p.update_goldens = false;
+		x.configure( p );
+		x.create( "equal empty" ).matches_golden( path, std::string() );
+		std::remove( path.c_str() );
+
+		auto& logs = x.logs();
+		t.equal( logs.size(), std::size_t{6} );
+		t.equal( x.failed_testcases(), 2 );
+		t.equal( logs.at(0).entries.at(0).message(), std::string( 
+			"Golden file [selftest_golden.bin] doesn't exist." ) );
+		t.equal( logs.at(2).check_count, 2 );
+		t.equal( logs.at(3).entries.at(0).message(), std::string( 
+			"Golden file [selftest_golden.bin] differs at offset "
+			"150000. Expected [58 5f 66 6d 74 7b 82 89 (90) 97 9e a5 "
+			"ac b3 ba c1 c8], but found [58 5f 66 6d 74 7b 82 89 (41) "
+			"97 9e a5 ac b3 ba c1 c8]." ) );
+		t.equal( logs.at(3).entries.at(1).message(), std::string( 
+			"Golden file [selftest_golden.bin] differs at offset 3. "
+			"Size is 3, but should be 200000. Expected [00 07 0e (15) "
+			"1c 23 2a 31 38 3f 46 4d], but found [00 07 0e]." ) );
+		t.equal( logs.at(5).failed_count, 0 );
+	}
+
 	std::cout << tb << '\n';
 
 	return tb.failed_testcases();
@@ -255,5 +1333,16 @@ bool operator>(const A&, const A&) {
 	return false;
 }
 
+std::ostream& operator<<(std::ostream& os, const B& b) {
+	B::written++;
+	os << b.value;
+	return os;
+}
 
+bool operator==(const B& a, const B& b) {
+	return a.value == b.value;
+}
 
+bool operator<(const B& a, const B& b) {
+	return a.value < b.value;
+}
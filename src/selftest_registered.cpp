@@ -0,0 +1,32 @@
+//
+// project........: testbench
+//
+// file...........: src/selftest_registered.cpp
+//
+// author.........: elratmacfat
+//
+// description....: testcases registered by a second translation unit of the 
+//                  selftest, which also checks that the header can be 
+//                  included more than once per program.
+//
+#include "elrat/testbench.h"
+
+ELRAT_TESTCASE( "registered passing" ) {
+	tc.check( true );
+	tc.equal( 1 + 1, 2 );
+}
+
+ELRAT_TESTCASE( "registered failing" ) {
+	tc.check( false );
+}
+
+ELRAT_TESTCASE( "registered other" ) {
+	tc.less_than( 1, 2 );
+}
+
+// Several testcases registered on one line, by a macro
+#define SELFTEST_PAIR( name ) \
+	ELRAT_TESTCASE( name " (first)" ) { tc.check( true ); } \
+	ELRAT_TESTCASE( name " (second)" ) { tc.check( true ); }
+
+SELFTEST_PAIR( "registered pair" )